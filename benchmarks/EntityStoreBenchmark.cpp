@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <glm/gtc/constants.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "EntityStore.h"
+#include "TransformKernel.h"
+
+// Per-frame CPU cost of the entity update plus the per-draw data handed to the command buffer, for
+// the old array of GameObjects against the EntityStore.
+//
+// aos: the layout the client had before the EntityStore, one GameObject per entity holding its
+// model by shared_ptr. every frame bumps the rotation and builds the push constants of one draw per
+// object, as renderGameObjects did. soa: the rotation update over the dense array, the counting sort
+// by model and the instance records written by TransformKernel, as RenderSystem does now. No
+// Vulkan calls are made by either, the models are only used as keys.
+//
+//     EntityStoreBenchmark
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t ENTITY_COUNTS[] = {10000, 100000, 1000000};
+static constexpr uint32_t MODEL_COUNT = 8;
+static constexpr int FRAMES = 20;
+
+struct GameObject
+{
+    std::shared_ptr<Model> model;
+    glm::vec3 color{};
+    Transform2dComponent transform_2d{};
+};
+
+struct SimplePushConstantData
+{
+    glm::mat2 transform{1.f};
+    glm::vec2 offset;
+    alignas(16) glm::vec3 color;
+};
+
+struct Draw
+{
+    const Model *model;
+    SimplePushConstantData push;
+};
+
+// the models are never dereferenced, distinct addresses are all the loops need
+static std::vector<std::shared_ptr<Model>> makeModels()
+{
+    auto storage = std::make_shared<std::vector<char>>(MODEL_COUNT);
+    std::vector<std::shared_ptr<Model>> models;
+
+    for (uint32_t i = 0; i < MODEL_COUNT; i++) {
+        models.emplace_back(storage, reinterpret_cast<Model *>(storage->data() + i));
+    }
+
+    return models;
+}
+
+static Transform2dComponent transformOf(uint32_t i)
+{
+    Transform2dComponent transform{};
+
+    transform.translation = {
+        static_cast<float>(i % 1000) * .002f - 1.f,
+        static_cast<float>(i / 1000 % 1000) * .002f - 1.f
+    };
+    transform.scale = {.01f, .01f};
+    transform.rotation = static_cast<float>(i % 628) * .01f;
+
+    return transform;
+}
+
+static glm::vec3 colorOf(uint32_t i)
+{
+    return {static_cast<float>(i % 3) * .5f, static_cast<float>(i % 5) * .25f, 1.f};
+}
+
+static double microseconds(Clock::duration elapsed)
+{
+    return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+static double aosFrame(const std::vector<std::shared_ptr<Model>> &models, uint32_t count)
+{
+    std::vector<GameObject> objects;
+    std::vector<Draw> draws;
+
+    objects.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        objects.push_back({models[i % MODEL_COUNT], colorOf(i), transformOf(i)});
+    }
+
+    double best = 1e30;
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        auto start = Clock::now();
+
+        draws.clear();
+
+        for (auto &object: objects) {
+            object.transform_2d.rotation = glm::mod(object.transform_2d.rotation + .01f, glm::two_pi<float>());
+
+            SimplePushConstantData push{};
+
+            push.transform = object.transform_2d.mat2();
+            push.offset = object.transform_2d.translation;
+            push.color = object.color;
+
+            draws.push_back({object.model.get(), push});
+        }
+
+        best = std::min(best, microseconds(Clock::now() - start));
+    }
+
+    return best;
+}
+
+static double soaFrame(const std::vector<std::shared_ptr<Model>> &models, uint32_t count)
+{
+    EntityStore store;
+    std::vector<uint32_t> model_offsets;
+    std::vector<uint32_t> draw_order;
+    std::vector<Model::Instance> instances;
+
+    for (auto &model: models) {
+        store.addModel(model);
+    }
+
+    store.reserve(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        store.create(i % MODEL_COUNT, transformOf(i), colorOf(i));
+    }
+
+    double best = 1e30;
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        auto start = Clock::now();
+
+        for (auto &rotation: store.rotations()) {
+            rotation = glm::mod(rotation + .01f, glm::two_pi<float>());
+        }
+
+        auto handles = store.models();
+
+        model_offsets.assign(store.modelCount(), 0);
+
+        for (auto model: handles) {
+            model_offsets[model]++;
+        }
+
+        uint32_t offset = 0;
+
+        for (auto &model_offset: model_offsets) {
+            uint32_t instance_count = model_offset;
+
+            model_offset = offset;
+            offset += instance_count;
+        }
+
+        draw_order.resize(store.size());
+        instances.resize(store.size());
+
+        for (uint32_t i = 0; i < handles.size(); i++) {
+            draw_order[model_offsets[handles[i]]++] = i;
+        }
+
+        TransformKernel::Input input{
+            draw_order.data(),
+            store.translations().data(),
+            store.scales().data(),
+            store.rotations().data(),
+            store.colors().data()
+        };
+
+        TransformKernel::writeInstances(input, instances.data(), 0, store.size());
+
+        best = std::min(best, microseconds(Clock::now() - start));
+    }
+
+    return best;
+}
+
+int main()
+{
+    auto models = makeModels();
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "transform kernel: " << TransformKernel::selectedName() << std::endl;
+    std::cout << "entities   aos us/frame   soa us/frame   speedup" << std::endl;
+
+    for (uint32_t count: ENTITY_COUNTS) {
+        double aos = aosFrame(models, count);
+        double soa = soaFrame(models, count);
+
+        std::cout << std::setw(8) << count
+                  << std::setw(15) << aos
+                  << std::setw(15) << soa
+                  << std::setw(9) << std::setprecision(2) << aos / soa << std::setprecision(1) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+// Throughput and wake-up latency of JobSystem for 1..N workers.
+//
+// throughput: a non-worker thread submits small jobs against one counter and waits for them,
+// like the render thread recording secondaries. fan-out: one job per worker submits the same
+// number of jobs from inside the pool, so they land in the workers' own deques and get stolen.
+// latency: one job at a time from an idle pool, submit to first instruction of the job. whichever
+// comes first runs it, a woken worker or the waiting thread itself.
+//
+//     JobSystemBenchmark [max_workers]
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t JOBS = 200000;
+static constexpr uint32_t LATENCY_SAMPLES = 5000;
+
+// roughly 100ns of work that the compiler cannot drop
+static void spin(std::atomic<uint64_t> &sink, uint32_t seed)
+{
+    uint64_t value = seed;
+
+    for (int i = 0; i < 64; i++) {
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    }
+
+    sink.fetch_add(value & 1, std::memory_order_relaxed);
+}
+
+static double jobsPerSecond(uint32_t jobs, Clock::duration elapsed)
+{
+    return jobs / std::chrono::duration<double>(elapsed).count();
+}
+
+static double externalSubmit(JobSystem &system)
+{
+    std::atomic<uint64_t> sink{0};
+    JobCounter counter;
+
+    auto start = Clock::now();
+
+    for (uint32_t i = 0; i < JOBS; i++) {
+        system.submit([&sink, i]() { spin(sink, i); }, &counter);
+    }
+
+    system.wait(counter);
+
+    return jobsPerSecond(JOBS, Clock::now() - start);
+}
+
+static double fanOut(JobSystem &system)
+{
+    std::atomic<uint64_t> sink{0};
+    JobCounter spawners;
+    JobCounter counter;
+    uint32_t per_worker = JOBS / system.workerCount();
+
+    auto start = Clock::now();
+
+    for (uint32_t worker = 0; worker < system.workerCount(); worker++) {
+        system.submit([&system, &sink, &counter, per_worker]() {
+            for (uint32_t i = 0; i < per_worker; i++) {
+                system.submit([&sink, i]() { spin(sink, i); }, &counter);
+            }
+        }, &spawners);
+    }
+
+    system.wait(spawners);
+    system.wait(counter);
+
+    return jobsPerSecond(per_worker * system.workerCount(), Clock::now() - start);
+}
+
+static void latency(JobSystem &system, double &median_us, double &p99_us)
+{
+    std::vector<double> samples;
+
+    samples.reserve(LATENCY_SAMPLES);
+
+    for (uint32_t i = 0; i < LATENCY_SAMPLES; i++) {
+        Clock::time_point started;
+        JobCounter counter;
+
+        // give the workers time to fall asleep, the latency of interest is the wake-up
+        if (i % 16 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds{200});
+        }
+
+        auto submitted = Clock::now();
+
+        system.submit([&started]() { started = Clock::now(); }, &counter);
+        system.wait(counter);
+
+        samples.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    median_us = samples[samples.size() / 2];
+    p99_us = samples[samples.size() * 99 / 100];
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t max_workers = argc > 1
+                           ? static_cast<uint32_t>(std::stoul(argv[1]))
+                           : JobSystem::defaultWorkerCount();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "workers  submit Mjobs/s  fan-out Mjobs/s  latency median us  latency p99 us" << std::endl;
+
+    for (uint32_t workers = 1; workers <= max_workers; workers++) {
+        JobSystem system{workers};
+
+        double submit = externalSubmit(system);
+        double fan_out = fanOut(system);
+        double median_us;
+        double p99_us;
+
+        latency(system, median_us, p99_us);
+
+        std::cout << std::setw(7) << workers
+                  << std::setw(17) << submit / 1e6
+                  << std::setw(17) << fan_out / 1e6
+                  << std::setw(19) << median_us
+                  << std::setw(16) << p99_us << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
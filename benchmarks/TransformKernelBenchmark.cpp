@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "TransformKernel.h"
+
+// Instance records per second for each TransformKernel path. sequential: the draw order is the
+// dense order, as with a single model. gathered: the draw order is a permutation of the slots, as
+// after the counting sort by model with many models interleaved.
+//
+//     TransformKernelBenchmark [instances]
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int REPEATS = 20;
+
+struct Path
+{
+    const char *name;
+    TransformKernel::Function function;
+};
+
+static double nanosecondsPerInstance(
+    TransformKernel::Function function,
+    const TransformKernel::Input &input,
+    std::vector<Model::Instance> &instances
+)
+{
+    auto count = static_cast<uint32_t>(instances.size());
+    double best = 1e30;
+
+    for (int repeat = 0; repeat < REPEATS; repeat++) {
+        auto start = Clock::now();
+
+        function(input, instances.data(), 0, count);
+
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    return best / count;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 1000000;
+
+    std::vector<uint32_t> sequential(count);
+    std::vector<uint32_t> gathered(count);
+    std::vector<glm::vec2> translations(count);
+    std::vector<glm::vec2> scales(count, glm::vec2{.01f, .01f});
+    std::vector<float> rotations(count);
+    std::vector<glm::vec3> colors(count);
+    std::vector<Model::Instance> instances(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        sequential[i] = i;
+        gathered[i] = static_cast<uint32_t>((static_cast<uint64_t>(i) * 7919) % count);
+        rotations[i] = static_cast<float>(i % 628) * .01f;
+    }
+
+    std::vector<Path> paths{{"scalar", &TransformKernel::scalar}};
+
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+    paths.push_back({"sse2", &TransformKernel::sse2});
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        paths.push_back({"avx2", &TransformKernel::avx2});
+    }
+#endif
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << count << " instances, selected path " << TransformKernel::selectedName() << std::endl;
+    std::cout << "path     sequential ns/instance  gathered ns/instance" << std::endl;
+
+    TransformKernel::Input in_order{
+        sequential.data(), translations.data(), scales.data(), rotations.data(), colors.data()
+    };
+    TransformKernel::Input shuffled{
+        gathered.data(), translations.data(), scales.data(), rotations.data(), colors.data()
+    };
+
+    for (auto &path: paths) {
+        std::cout << std::setw(6) << path.name
+                  << std::setw(25) << nanosecondsPerInstance(path.function, in_order, instances)
+                  << std::setw(22) << nanosecondsPerInstance(path.function, shuffled, instances) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#ifndef MELLIANCLIENT_ALLOCATIONCOUNTER_H
+#define MELLIANCLIENT_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Heap allocations counted by the replacement operator new in Main.cpp when
+// MELLIANCLIENT_COUNT_ALLOCATIONS is defined, per thread and for the whole process. Work handed to
+// the job system allocates on the workers, so only the process count covers it. Without the define
+// both stay zero and ENABLED tells callers not to trust them.
+class AllocationCounter
+{
+public:
+#ifdef MELLIANCLIENT_COUNT_ALLOCATIONS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    static uint64_t thisThread()
+    {
+        return count;
+    }
+
+    static uint64_t allThreads()
+    {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    static void record()
+    {
+        count++;
+        total.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    static inline thread_local uint64_t count = 0;
+    static inline std::atomic<uint64_t> total{0};
+};
+
+#endif //MELLIANCLIENT_ALLOCATIONCOUNTER_H
@@ -4,14 +4,34 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#include <iostream>
 #include <memory>
+#include <random>
 #include <stdexcept>
+#include <thread>
+#include <vector>
+#include "AllocationCounter.h"
 #include "Device.h"
-#include "GameObject.h"
+#include "EntityStore.h"
+#include "FrameQueue.h"
+#include "FrameStats.h"
+#include "GeometryPool.h"
+#include "JobSystem.h"
+#include "Options.h"
+#include "PipelineCompiler.h"
 #include "Renderer.h"
 #include "RenderSystem.h"
+#include "Simulation.h"
+#include "Trace.h"
+#include "TransformKernel.h"
+#include "UploadQueue.h"
 #include "Window.h"
 
 class App
@@ -20,9 +40,26 @@ public:
     static constexpr int WIDTH = 1280;
     static constexpr int HEIGHT = 720;
 
-    App()
+    static constexpr uint32_t BENCHMARK_WARMUP_FRAMES = 60;
+    static constexpr uint32_t RECORD_REPORT_INTERVAL = 256;
+    static constexpr uint32_t GPU_REPORT_INTERVAL = 256;
+    static constexpr size_t FRAME_QUEUE_CAPACITY = 2;
+    // a new packet is only made while none is free or recycled, so besides the one being filled
+    // there is at most a full frame queue and the one the render thread holds
+    static constexpr size_t MAX_PACKETS = FRAME_QUEUE_CAPACITY + 2;
+    static constexpr size_t RECYCLE_QUEUE_CAPACITY = 4;
+
+    static_assert(RECYCLE_QUEUE_CAPACITY >= MAX_PACKETS, "every packet must fit in the recycle queue");
+
+    App(const Options &options) : options{options}
     {
-        loadGameObjects();
+        if (options.stress_objects > 0) {
+            loadStressScene(options.stress_objects, options.stress_models);
+        } else {
+            loadEntities();
+        }
+
+        simulation.reset();
     }
 
     App(const App &) = delete;
@@ -31,29 +68,357 @@ public:
 
     void run()
     {
-        RenderSystem render_system{device, renderer.getSwapChainRenderPass()};
+        RenderSystem render_system{device, renderer, pipeline_compiler, options.parallel ? &jobs : nullptr, options.indirect};
+
+        if (options.stress_objects > 0) {
+            std::cout << "transform kernel: " << TransformKernel::selectedName() << std::endl;
+        }
+
+        if (!options.trace_output.empty() && !Trace::ENABLED) {
+            std::cout << "cpu tracing unavailable: built without MELLIANCLIENT_TRACE" << std::endl;
+        }
+
+        TRACE_THREAD_NAME("main");
+
+        std::thread render_thread{[this, &render_system]() { renderLoop(render_system); }};
+
+        FramePacket *filling = nullptr;
+        auto last_frame = std::chrono::steady_clock::now();
+
+        // the main thread only handles input and simulation, while the render thread still holds an
+        // unconsumed packet it waits for events for at most one simulation step. in low latency mode it
+        // instead waits until the render thread has a free frame slot and asks for the next frame
+        while (!window.shouldClose() && !render_failed.load(std::memory_order_acquire)) {
+            if (window.isMinimized()) {
+                window.waitEvents();
+            } else if (options.low_latency) {
+                if (requested.load(std::memory_order_acquire) <= published.load(std::memory_order_acquire)) {
+                    window.waitEventsTimeout(Simulation::STEP_SECONDS);
+                    jobs.runMainThreadJobs();
+
+                    continue;
+                }
+
+                window.pollEvents();
+            } else if (published.load(std::memory_order_acquire) > taken.load(std::memory_order_acquire)) {
+                window.waitEventsTimeout(Simulation::STEP_SECONDS);
+            } else {
+                window.pollEvents();
+            }
+
+            TRACE_ZONE("App::run frame");
+
+            jobs.runMainThreadJobs();
+
+            auto now = std::chrono::steady_clock::now();
 
-        while (!window.shouldClose()) {
-            glfwPollEvents();
+            {
+                TRACE_ZONE("wait for simulation");
 
-            if (auto command_buffer = renderer.beginFrame()) {
-                renderer.beginSwapChainRenderPass(command_buffer);
-                render_system.renderGameObjects(command_buffer, game_objects);
-                renderer.endSwapChainRenderPass(command_buffer);
-                renderer.endFrame();
+                simulation.wait();
+            }
+
+            if (filling != nullptr) {
+                publish(filling);
+            }
+
+            filling = acquirePacket();
+            filling->frame = frame_counter++;
+            filling->sampled_at = now;
+
+            if (options.churn_per_frame > 0) {
+                churn(options.churn_per_frame);
+            }
+
+            // benchmarks advance by exactly one step per frame so every run simulates the same states
+            double frame_seconds = options.benchmark_output.empty()
+                                   ? std::chrono::duration<double>(now - last_frame).count()
+                                   : Simulation::STEP_SECONDS;
+
+            simulation.launch(frame_seconds, filling->snapshot);
+            last_frame = now;
+
+            if (options.low_latency) {
+                simulation.wait();
+                publish(filling);
+
+                filling = nullptr;
             }
         }
 
+        simulation.wait();
+
+        stop_rendering.store(true, std::memory_order_release);
+        published.fetch_add(1, std::memory_order_release);
+        published.notify_one();
+        render_thread.join();
+
         vkDeviceWaitIdle(device.device());
+
+        if (render_error) {
+            std::rethrow_exception(render_error);
+        }
+
+        if (!options.benchmark_output.empty()) {
+            writeBenchmark(render_system);
+        }
+
+        if (!options.gpu_trace_output.empty()) {
+            renderer.getProfiler().writeTrace(options.gpu_trace_output);
+        }
+
+        if (!options.trace_output.empty() && Trace::ENABLED) {
+            Trace::writeChrome(options.trace_output);
+        }
+
+        auto pipeline_stats = pipeline_compiler.getStats();
+
+        std::cout << "pipelines: " << pipeline_stats.misses << " compiled, "
+                  << pipeline_stats.hits << " reused" << std::endl;
     }
 
 private:
-    Window window{WIDTH, HEIGHT, "WoW"};
+    Options options;
+    JobSystem jobs;
+    Window window{WIDTH, HEIGHT, "WoW", options.headless};
     Device device{window};
-    Renderer renderer{window, device};
-    std::vector<GameObject> game_objects;
+    UploadQueue upload_queue{device};
+    GeometryPool geometry{device, upload_queue, sizeof(Model::Vertex)};
+    PipelineCompiler pipeline_compiler{device, jobs};
+    Renderer renderer{window, device, options.swap_chain};
+    EntityStore entities;
+    Simulation simulation{jobs, entities};
+
+    // written once by the main thread, read by the render thread and then handed back for reuse
+    struct FramePacket
+    {
+        uint64_t frame;
+        // when the input this packet was simulated from got polled
+        std::chrono::steady_clock::time_point sampled_at;
+        Simulation::Snapshot snapshot;
+    };
+
+    std::vector<std::unique_ptr<FramePacket>> packets;
+    std::vector<FramePacket *> free_packets;
+    FrameQueue<FramePacket *, FRAME_QUEUE_CAPACITY> frame_queue;
+    FrameQueue<FramePacket *, RECYCLE_QUEUE_CAPACITY> recycled_packets;
+    uint64_t frame_counter = 0;
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> taken{0};
+    std::atomic<uint64_t> requested{0};
+    std::atomic<bool> stop_rendering{false};
+    std::atomic<bool> render_failed{false};
+    std::exception_ptr render_error;
+    FrameStats frame_stats{BENCHMARK_WARMUP_FRAMES};
+    // the stress scene and the churn draw from one fixed seed so runs stay comparable
+    std::mt19937 random{1337};
+
+    static const char *recordMode(const RenderSystem &render_system)
+    {
+        if (render_system.usesIndirect()) {
+            return "indirect";
+        }
+
+        return render_system.recordsSecondaries() ? "parallel" : "instanced";
+    }
+
+    void writeBenchmark(const RenderSystem &render_system)
+    {
+        std::ofstream file{options.benchmark_output};
+
+        if (!file) {
+            throw std::runtime_error("failed to open benchmark output: " + options.benchmark_output);
+        }
+
+        frame_stats.writeJson(file, {
+            device.properties.deviceName,
+            entities.size(),
+            entities.modelCount(),
+            recordMode(render_system),
+            renderer.framesInFlight(),
+            SwapChain::presentModeName(renderer.getPresentMode()),
+            static_cast<uint32_t>(renderer.imageCount()),
+            options.low_latency
+        });
+    }
+
+    FramePacket *acquirePacket()
+    {
+        if (!free_packets.empty()) {
+            auto packet = free_packets.back();
+
+            free_packets.pop_back();
+
+            return packet;
+        }
+
+        if (auto packet = recycled_packets.tryPop()) {
+            return *packet;
+        }
+
+        assert(packets.size() < MAX_PACKETS && "frame packet leaked");
+
+        packets.push_back(std::make_unique<FramePacket>());
+
+        return packets.back().get();
+    }
+
+    // a packet the render thread has not picked up yet is superseded by the newer one
+    void publish(FramePacket *packet)
+    {
+        if (auto dropped = frame_queue.pushDropOldest(packet)) {
+            free_packets.push_back(*dropped);
+            taken.fetch_add(1, std::memory_order_release);
+        }
+
+        published.fetch_add(1, std::memory_order_release);
+        published.notify_one();
+    }
 
-    void loadGameObjects()
+    // owns every Vulkan queue operation, so uploads are flushed here as well
+    void renderLoop(RenderSystem &render_system)
+    {
+        auto contents = render_system.recordsSecondaries()
+                        ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                        : VK_SUBPASS_CONTENTS_INLINE;
+        auto record_label = recordMode(render_system);
+
+        std::chrono::duration<double, std::milli> record_time{0};
+        uint32_t recorded_frames = 0;
+        uint64_t reported_allocations = AllocationCounter::thisThread();
+        uint64_t reported_all_allocations = AllocationCounter::allThreads();
+        uint64_t presented_frames = 0;
+        auto last_present = std::chrono::steady_clock::now();
+        auto &profiler = renderer.getProfiler();
+        bool frame_requested = false;
+
+        profiler.setTracing(!options.gpu_trace_output.empty());
+
+        TRACE_THREAD_NAME("render");
+
+        if (!options.benchmark_output.empty()) {
+            frame_stats.reserve(options.frame_limit);
+        }
+
+        if ((options.gpu_profile || !options.gpu_trace_output.empty()) && !profiler.isEnabled()) {
+            std::cout << "gpu profiling unavailable: the graphics queue cannot write timestamps" << std::endl;
+        }
+
+        try {
+            while (true) {
+                if (options.low_latency && !frame_requested) {
+                    renderer.waitForFrameSlot();
+
+                    requested.fetch_add(1, std::memory_order_release);
+                    window.postEmptyEvent();
+
+                    frame_requested = true;
+                }
+
+                uint64_t seen = published.load(std::memory_order_acquire);
+                auto packet = frame_queue.tryPop();
+
+                if (!packet) {
+                    if (stop_rendering.load(std::memory_order_acquire)) {
+                        break;
+                    }
+
+                    published.wait(seen, std::memory_order_acquire);
+
+                    continue;
+                }
+
+                taken.fetch_add(1, std::memory_order_release);
+                frame_requested = false;
+
+                TRACE_ZONE("App::renderLoop frame");
+
+                uint64_t frame_allocations = AllocationCounter::thisThread();
+                uint64_t frame_all_allocations = AllocationCounter::allThreads();
+
+                upload_queue.flush();
+                upload_queue.collect();
+
+                if (auto command_buffer = renderer.beginFrame()) {
+                    renderer.beginSwapChainRenderPass(command_buffer, contents);
+
+                    auto record_start = std::chrono::steady_clock::now();
+
+                    render_system.renderEntities(command_buffer, (*packet)->snapshot);
+
+                    std::chrono::duration<double, std::milli> frame_record_time =
+                        std::chrono::steady_clock::now() - record_start;
+
+                    record_time += frame_record_time;
+
+                    renderer.endSwapChainRenderPass(command_buffer);
+                    renderer.endFrame();
+
+                    auto now = std::chrono::steady_clock::now();
+
+                    frame_allocations = AllocationCounter::thisThread() - frame_allocations;
+                    frame_all_allocations = AllocationCounter::allThreads() - frame_all_allocations;
+
+                    if (!options.benchmark_output.empty()) {
+                        auto &timings = renderer.getFrameTimings();
+
+                        frame_stats.add({
+                            std::chrono::duration<double, std::milli>(now - last_present).count(),
+                            timings.acquire_ms,
+                            frame_record_time.count(),
+                            timings.submit_ms,
+                            timings.present_ms,
+                            timings.gpu_ms,
+                            std::chrono::duration<double, std::milli>(now - (*packet)->sampled_at).count(),
+                            AllocationCounter::ENABLED ? static_cast<double>(frame_allocations) : -1.,
+                            AllocationCounter::ENABLED ? static_cast<double>(frame_all_allocations) : -1.
+                        });
+                    }
+
+                    last_present = now;
+
+                    if (++presented_frames == options.frame_limit) {
+                        window.requestClose();
+                    }
+
+                    if (options.gpu_profile && profiler.isEnabled() && presented_frames % GPU_REPORT_INTERVAL == 0) {
+                        profiler.printSummary(std::cout);
+                    }
+
+                    if (options.stress_objects > 0 && ++recorded_frames == RECORD_REPORT_INTERVAL) {
+                        std::cout << record_label << " record: "
+                                  << record_time.count() / recorded_frames << " ms" << std::endl;
+
+                        // includes the allocations of the line above, which are outside the frame loop
+                        if (AllocationCounter::ENABLED) {
+                            std::cout << "heap allocations in " << recorded_frames << " frames: "
+                                      << AllocationCounter::thisThread() - reported_allocations
+                                      << " render thread, "
+                                      << AllocationCounter::allThreads() - reported_all_allocations
+                                      << " all threads" << std::endl;
+
+                            reported_allocations = AllocationCounter::thisThread();
+                            reported_all_allocations = AllocationCounter::allThreads();
+                        }
+
+                        record_time = record_time.zero();
+                        recorded_frames = 0;
+                    }
+                }
+
+                [[maybe_unused]] bool recycled = recycled_packets.tryPush(*packet);
+
+                assert(recycled && "recycle queue is smaller than the packets in circulation");
+                window.postEmptyEvent();
+            }
+        } catch (...) {
+            render_error = std::current_exception();
+            render_failed.store(true, std::memory_order_release);
+            window.postEmptyEvent();
+        }
+    }
+
+    void loadEntities()
     {
         std::vector<Model::Vertex> vertices{
             {{0.0f,  -0.5f}, {1.0f, 0.0f, 0.0f}},
@@ -61,17 +426,77 @@ private:
             {{-0.5f, 0.5f},  {0.0f, 0.0f, 1.0f}},
         };
 
-        auto model = std::make_shared<Model>(device, vertices);
+        auto model = entities.addModel(std::make_shared<Model>(geometry, vertices));
+
+        Transform2dComponent transform{};
+
+        transform.translation.x = .2f;
+        transform.scale = {2.f, .5f};
+        transform.rotation = .25f * glm::two_pi<float>();
+
+        entities.create(model, transform, {.1f, .8f, .1f});
+    }
+
+    // deterministic field of small polygons spread over a handful of shared models
+    void loadStressScene(uint32_t object_count, uint32_t model_count)
+    {
+        std::vector<EntityStore::ModelHandle> models;
+
+        for (uint32_t sides = 3; sides < 3 + model_count; sides++) {
+            std::vector<Model::Vertex> vertices;
+
+            for (uint32_t side = 0; side < sides; side++) {
+                float from = glm::two_pi<float>() * side / sides;
+                float to = glm::two_pi<float>() * (side + 1) / sides;
+
+                vertices.push_back({{0.f, 0.f}, {1.f, 1.f, 1.f}});
+                vertices.push_back({{.5f * glm::cos(from), .5f * glm::sin(from)}, {1.f, 1.f, 1.f}});
+                vertices.push_back({{.5f * glm::cos(to), .5f * glm::sin(to)}, {1.f, 1.f, 1.f}});
+            }
+
+            models.push_back(entities.addModel(std::make_shared<Model>(geometry, vertices)));
+        }
 
-        auto triangle = GameObject::createGameObject();
+        entities.reserve(object_count);
 
-        triangle.model = model;
-        triangle.color = {.1f, .8f, .1f};
-        triangle.transform_2d.translation.x = .2f;
-        triangle.transform_2d.scale = {2.f, .5f};
-        triangle.transform_2d.rotation = .25f * glm::two_pi<float>();
+        for (uint32_t i = 0; i < object_count; i++) {
+            spawn(models[i % models.size()]);
+        }
+    }
 
-        game_objects.push_back(std::move(triangle));
+    Entity spawn(EntityStore::ModelHandle model)
+    {
+        std::uniform_real_distribution<float> position{-1.f, 1.f};
+        std::uniform_real_distribution<float> size{.01f, .03f};
+        std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+        glm::vec3 color{unit(random), unit(random), unit(random)};
+        Transform2dComponent transform{};
+
+        transform.translation = {position(random), position(random)};
+        transform.scale = glm::vec2{size(random)};
+        transform.rotation = unit(random) * glm::two_pi<float>();
+
+        return entities.create(model, transform, color);
+    }
+
+    // runs between simulation.wait() and launch(), the render thread only reads published packets so
+    // it never sees the store change
+    void churn(uint32_t count)
+    {
+        TRACE_ZONE("App::churn");
+
+        std::uniform_int_distribution<EntityStore::ModelHandle> model{0, entities.modelCount() - 1};
+
+        for (uint32_t i = 0; i < count && entities.size() > 0; i++) {
+            std::uniform_int_distribution<uint32_t> slot{0, entities.size() - 1};
+
+            entities.destroy(entities.entities()[slot(random)]);
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            spawn(model(random));
+        }
     }
 };
 
@@ -0,0 +1,281 @@
+#ifndef MELLIANCLIENT_BINDLESSTABLE_H
+#define MELLIANCLIENT_BINDLESSTABLE_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "DeletionQueue.h"
+
+// One descriptor set holding every texture and storage buffer the renderer knows about, shaders pick
+// them by an integer index carried in per-object data instead of the CPU binding a set per material.
+// The arrays are partially bound and update-after-bind, so resources are added and removed while
+// command buffers that bind the set are pending, and unused slots never need a valid descriptor.
+//
+// Indices stay stable for the lifetime of the resource. A released index is only reused once every
+// frame that may still read it has finished, which the device's deletion queue tracks. The matching
+// GLSL declarations are in Shaders/bindless.glsl.
+class BindlessTable
+{
+public:
+    static constexpr uint32_t TEXTURE_BINDING = 0;
+    static constexpr uint32_t BUFFER_BINDING = 1;
+    static constexpr uint32_t MAX_TEXTURES = 16384;
+    static constexpr uint32_t MAX_BUFFERS = 4096;
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // max_textures and max_buffers are clamped to the device's update-after-bind limits
+    BindlessTable(VkDevice device, DeletionQueue &deletion_queue, uint32_t max_textures, uint32_t max_buffers)
+        : device{device}, deletion_queue{deletion_queue},
+          texture_slots{std::min(max_textures, MAX_TEXTURES)},
+          buffer_slots{std::min(max_buffers, MAX_BUFFERS)}
+    {
+        createLayout();
+        createPool();
+        allocateSet();
+    }
+
+    ~BindlessTable()
+    {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    }
+
+    BindlessTable(const BindlessTable &) = delete;
+
+    BindlessTable &operator=(BindlessTable &&) = delete;
+
+    VkDescriptorSetLayout getLayout() const
+    {
+        return layout;
+    }
+
+    VkDescriptorSet getSet() const
+    {
+        return set;
+    }
+
+    uint32_t addTexture(VkImageView image_view, VkSampler sampler, VkImageLayout image_layout)
+    {
+        VkDescriptorImageInfo image_info{};
+
+        image_info.sampler = sampler;
+        image_info.imageView = image_view;
+        image_info.imageLayout = image_layout;
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        uint32_t index = texture_slots.acquire();
+
+        if (index == INVALID_INDEX) {
+            throw std::runtime_error("bindless texture table is full");
+        }
+
+        VkWriteDescriptorSet write = makeWrite(TEXTURE_BINDING, index, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+        write.pImageInfo = &image_info;
+
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        return index;
+    }
+
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE)
+    {
+        VkDescriptorBufferInfo buffer_info{};
+
+        buffer_info.buffer = buffer;
+        buffer_info.offset = offset;
+        buffer_info.range = range;
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        uint32_t index = buffer_slots.acquire();
+
+        if (index == INVALID_INDEX) {
+            throw std::runtime_error("bindless buffer table is full");
+        }
+
+        VkWriteDescriptorSet write = makeWrite(BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+        write.pBufferInfo = &buffer_info;
+
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        return index;
+    }
+
+    // the resource itself has to outlive the frames in flight as well, see Device::deferDestroy*
+    void removeTexture(uint32_t index)
+    {
+        deletion_queue.defer([this, index]() {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            texture_slots.release(index);
+        });
+    }
+
+    void removeBuffer(uint32_t index)
+    {
+        deletion_queue.defer([this, index]() {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            buffer_slots.release(index);
+        });
+    }
+
+    void bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, uint32_t set_index) const
+    {
+        vkCmdBindDescriptorSets(
+            command_buffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipeline_layout,
+            set_index,
+            1,
+            &set,
+            0,
+            nullptr
+        );
+    }
+
+private:
+    // indices handed out lowest first, released ones are reused before the high water mark grows
+    class SlotList
+    {
+    public:
+        explicit SlotList(uint32_t capacity) : capacity{capacity}
+        {
+        }
+
+        uint32_t acquire()
+        {
+            if (!free_slots.empty()) {
+                uint32_t index = free_slots.back();
+
+                free_slots.pop_back();
+
+                return index;
+            }
+
+            return used < capacity ? used++ : INVALID_INDEX;
+        }
+
+        void release(uint32_t index)
+        {
+            assert(index < used && "index was never handed out");
+
+            free_slots.push_back(index);
+        }
+
+        uint32_t size() const
+        {
+            return capacity;
+        }
+
+    private:
+        uint32_t capacity;
+        uint32_t used = 0;
+        std::vector<uint32_t> free_slots;
+    };
+
+    VkDevice device;
+    DeletionQueue &deletion_queue;
+    SlotList texture_slots;
+    SlotList buffer_slots;
+    std::mutex mutex;
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+
+    void createLayout()
+    {
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+
+        bindings[0].binding = TEXTURE_BINDING;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = texture_slots.size();
+        bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+        bindings[1].binding = BUFFER_BINDING;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = buffer_slots.size();
+        bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+        std::array<VkDescriptorBindingFlagsEXT, 2> binding_flags{};
+
+        binding_flags.fill(
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+        );
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info{};
+
+        flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+        flags_info.pBindingFlags = binding_flags.data();
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.pNext = &flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor set layout");
+        }
+    }
+
+    void createPool()
+    {
+        std::array<VkDescriptorPoolSize, 2> pool_sizes{{
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture_slots.size()},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_slots.size()},
+        }};
+
+        VkDescriptorPoolCreateInfo pool_info{};
+
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        pool_info.maxSets = 1;
+        pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+        pool_info.pPoolSizes = pool_sizes.data();
+
+        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool");
+        }
+    }
+
+    void allocateSet()
+    {
+        VkDescriptorSetAllocateInfo alloc_info{};
+
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &layout;
+
+        if (vkAllocateDescriptorSets(device, &alloc_info, &set) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set");
+        }
+    }
+
+    VkWriteDescriptorSet makeWrite(uint32_t binding, uint32_t index, VkDescriptorType type) const
+    {
+        VkWriteDescriptorSet write{};
+
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+
+        return write;
+    }
+};
+
+#endif //MELLIANCLIENT_BINDLESSTABLE_H
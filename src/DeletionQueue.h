@@ -0,0 +1,112 @@
+#ifndef MELLIANCLIENT_DELETIONQUEUE_H
+#define MELLIANCLIENT_DELETIONQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Holds back the destruction of GPU objects until every frame that may still reference them has
+// finished. Each deleter is stamped with the index of the frame being recorded when it was queued,
+// the renderer reports which frame indices are known to be complete once it waited on a frame
+// fence, so nothing here ever waits on the GPU.
+//
+// Deleters can be queued from any thread and run on the thread that calls collect, which is the
+// render thread.
+class DeletionQueue
+{
+public:
+    using Deleter = std::function<void()>;
+
+    DeletionQueue() = default;
+
+    DeletionQueue(const DeletionQueue &) = delete;
+
+    DeletionQueue &operator=(DeletionQueue &&) = delete;
+
+    void defer(Deleter deleter)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        // read under the lock so stamps stay ordered and collect can stop at the first pending entry
+        entries.push_back({submitted.load(std::memory_order_acquire), std::move(deleter)});
+    }
+
+    // called once a frame was submitted, the next deleters belong to the frame after it
+    void markSubmitted()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        submitted.fetch_add(1, std::memory_order_release);
+    }
+
+    uint64_t submittedFrames() const
+    {
+        return submitted.load(std::memory_order_acquire);
+    }
+
+    // runs every deleter queued while a frame older than first_pending_frame was recorded
+    void collect(uint64_t first_pending_frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            while (!entries.empty() && entries.front().frame < first_pending_frame) {
+                ready.push_back(std::move(entries.front().deleter));
+                entries.pop_front();
+            }
+        }
+
+        runReady();
+    }
+
+    // the device must be idle
+    void flush()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            for (auto &entry: entries) {
+                ready.push_back(std::move(entry.deleter));
+            }
+
+            entries.clear();
+        }
+
+        runReady();
+    }
+
+    size_t pendingCount()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        return entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t frame;
+        Deleter deleter;
+    };
+
+    std::mutex mutex;
+    std::deque<Entry> entries;
+    std::atomic<uint64_t> submitted{0};
+    // deleters run outside the lock since they may queue further deleters
+    std::vector<Deleter> ready;
+
+    void runReady()
+    {
+        for (auto &deleter: ready) {
+            deleter();
+        }
+
+        ready.clear();
+    }
+};
+
+#endif //MELLIANCLIENT_DELETIONQUEUE_H
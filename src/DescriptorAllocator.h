@@ -0,0 +1,168 @@
+#ifndef MELLIANCLIENT_DESCRIPTORALLOCATOR_H
+#define MELLIANCLIENT_DESCRIPTORALLOCATOR_H
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Owns descriptor set layouts and hands out descriptor sets from a growing list of pools. Layouts
+// are cached by their bindings so systems asking for the same shape share one VkDescriptorSetLayout,
+// which also keeps their pipeline layouts compatible. A pool that runs dry is kept for the sets it
+// already holds and a fresh one takes the next allocations.
+class DescriptorAllocator
+{
+public:
+    static constexpr uint32_t SETS_PER_POOL = 64;
+
+    struct Set
+    {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+    };
+
+    explicit DescriptorAllocator(VkDevice device) : device{device}
+    {
+    }
+
+    ~DescriptorAllocator()
+    {
+        for (auto pool: pools) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+
+        for (auto &[key, layout]: layouts) {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        }
+    }
+
+    DescriptorAllocator(const DescriptorAllocator &) = delete;
+
+    DescriptorAllocator &operator=(DescriptorAllocator &&) = delete;
+
+    // the layout lives as long as the allocator, callers must not destroy it
+    VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+    {
+        LayoutKey key;
+
+        for (const auto &binding: bindings) {
+            key.emplace_back(binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags);
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (auto it = layouts.find(key); it != layouts.end()) {
+            return it->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layout_info{};
+
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+
+        if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout");
+        }
+
+        layouts.emplace(std::move(key), layout);
+
+        return layout;
+    }
+
+    Set allocate(VkDescriptorSetLayout layout)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (!pools.empty()) {
+            Set set{VK_NULL_HANDLE, pools.back()};
+            auto result = allocateFrom(set.pool, layout, set.set);
+
+            if (result == VK_SUCCESS) {
+                return set;
+            }
+
+            if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+                throw std::runtime_error("failed to allocate descriptor set");
+            }
+        }
+
+        Set set{VK_NULL_HANDLE, createPool()};
+
+        if (allocateFrom(set.pool, layout, set.set) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set");
+        }
+
+        return set;
+    }
+
+    // the set must no longer be referenced by a pending command buffer, see Device::deferFree
+    void free(Set &set)
+    {
+        if (set.set == VK_NULL_HANDLE) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        vkFreeDescriptorSets(device, set.pool, 1, &set.set);
+        set = {};
+    }
+
+private:
+    using LayoutKey = std::vector<std::tuple<uint32_t, VkDescriptorType, uint32_t, VkShaderStageFlags>>;
+
+    // descriptors per pool for each type, a set asking for more than this of one type cannot be served
+    static constexpr std::array<VkDescriptorPoolSize, 5> POOL_SIZES{{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 * SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 * SETS_PER_POOL},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 * SETS_PER_POOL},
+    }};
+
+    VkDevice device;
+    std::mutex mutex;
+    std::map<LayoutKey, VkDescriptorSetLayout> layouts;
+    std::vector<VkDescriptorPool> pools;
+
+    VkDescriptorPool createPool()
+    {
+        VkDescriptorPoolCreateInfo pool_info{};
+
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        pool_info.maxSets = SETS_PER_POOL;
+        pool_info.poolSizeCount = static_cast<uint32_t>(POOL_SIZES.size());
+        pool_info.pPoolSizes = POOL_SIZES.data();
+
+        VkDescriptorPool pool;
+
+        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool");
+        }
+
+        pools.push_back(pool);
+
+        return pool;
+    }
+
+    VkResult allocateFrom(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet &set)
+    {
+        VkDescriptorSetAllocateInfo alloc_info{};
+
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = pool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &layout;
+
+        return vkAllocateDescriptorSets(device, &alloc_info, &set);
+    }
+};
+
+#endif //MELLIANCLIENT_DESCRIPTORALLOCATOR_H
@@ -1,11 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <set>
 #include <vector>
 #include <unordered_set>
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
+#include "DescriptorAllocator.h"
+#include "MemoryAllocator.h"
 #include "Window.h"
 
 struct SwapChainSupportDetails
@@ -19,8 +28,10 @@ struct QueueFamilyIndices
 {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;
 
     bool isComplete()
     {
@@ -87,12 +98,25 @@ public:
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        createAllocator();
+        createDescriptorAllocator();
+        createBindlessTable();
         createCommandPool();
+        createPipelineCache();
     }
 
     ~Device()
     {
+        vkDeviceWaitIdle(device_);
+        deletion_queue.flush();
+
+        savePipelineCache();
+        vkDestroyPipelineCache(device_, pipeline_cache, nullptr);
+        vkDestroyCommandPool(device_, transfer_command_pool, nullptr);
         vkDestroyCommandPool(device_, command_pool, nullptr);
+        bindless_table.reset();
+        descriptor_allocator.reset();
+        allocator.reset();
         vkDestroyDevice(device_, nullptr);
 
         if (enableValidationLayers) {
@@ -116,11 +140,26 @@ public:
         return command_pool;
     }
 
+    VkCommandPool getTransferCommandPool()
+    {
+        return transfer_command_pool;
+    }
+
+    VkPipelineCache pipelineCache()
+    {
+        return pipeline_cache;
+    }
+
     VkDevice device()
     {
         return device_;
     }
 
+    VkPhysicalDevice physicalDevice()
+    {
+        return physical_device;
+    }
+
     VkSurfaceKHR surface()
     {
         return surface_;
@@ -136,23 +175,48 @@ public:
         return presentQueue_;
     }
 
+    // a transfer-only family when the device has one, otherwise the graphics queue itself
+    VkQueue transferQueue()
+    {
+        return transferQueue_;
+    }
+
     SwapChainSupportDetails getSwapChainSupport()
     {
         return querySwapChainSupport(physical_device);
     }
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    MemoryAllocator &getAllocator()
     {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physical_device, &memProperties);
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if ((typeFilter & (1 << i)) &&
-                (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
-            }
-        }
+        return *allocator;
+    }
+
+    DeletionQueue &deletionQueue()
+    {
+        return deletion_queue;
+    }
+
+    DescriptorAllocator &getDescriptorAllocator()
+    {
+        return *descriptor_allocator;
+    }
+
+    // needs descriptor indexing with update-after-bind, systems fall back to per-draw sets without it
+    bool supportsBindless() const
+    {
+        return bindless_table != nullptr;
+    }
 
-        throw std::runtime_error("failed to find suitable memory type!");
+    BindlessTable &getBindlessTable()
+    {
+        assert(bindless_table != nullptr && "device does not support bindless descriptors");
+
+        return *bindless_table;
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        return allocator->findMemoryType(typeFilter, properties);
     }
 
     QueueFamilyIndices findPhysicalQueueFamilies()
@@ -185,7 +249,7 @@ public:
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory
+        Allocation &bufferAllocation
     )
     {
         VkBufferCreateInfo bufferInfo{};
@@ -201,16 +265,17 @@ public:
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        bufferAllocation = allocator->allocate(memRequirements, properties, MemoryAllocator::ResourceKind::Linear);
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+        if (vkBindBufferMemory(device_, buffer, bufferAllocation.memory, bufferAllocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind buffer memory!");
         }
+    }
 
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    void destroyBuffer(VkBuffer buffer, Allocation &bufferAllocation)
+    {
+        vkDestroyBuffer(device_, buffer, nullptr);
+        allocator->free(bufferAllocation);
     }
 
     VkCommandBuffer beginSingleTimeCommands()
@@ -291,7 +356,7 @@ public:
         const VkImageCreateInfo &imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage &image,
-        VkDeviceMemory &imageMemory
+        Allocation &imageAllocation
     )
     {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
@@ -301,21 +366,69 @@ public:
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        MemoryAllocator::ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_LINEAR
+                                             ? MemoryAllocator::ResourceKind::Linear
+                                             : MemoryAllocator::ResourceKind::Optimal;
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
-        }
+        imageAllocation = allocator->allocate(memRequirements, properties, kind);
 
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+        if (vkBindImageMemory(device_, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
             throw std::runtime_error("failed to bind image memory!");
         }
     }
 
+    void destroyImage(VkImage image, Allocation &imageAllocation)
+    {
+        vkDestroyImage(device_, image, nullptr);
+        allocator->free(imageAllocation);
+    }
+
+    // the deferred variants release objects once the frames that may still use them have finished,
+    // so unloading never has to idle the device
+    void deferDestroyBuffer(VkBuffer buffer, Allocation bufferAllocation)
+    {
+        deletion_queue.defer([this, buffer, bufferAllocation]() mutable {
+            destroyBuffer(buffer, bufferAllocation);
+        });
+    }
+
+    void deferDestroyImage(VkImage image, Allocation imageAllocation)
+    {
+        deletion_queue.defer([this, image, imageAllocation]() mutable {
+            destroyImage(image, imageAllocation);
+        });
+    }
+
+    void deferDestroyImageView(VkImageView image_view)
+    {
+        deletion_queue.defer([this, image_view]() {
+            vkDestroyImageView(device_, image_view, nullptr);
+        });
+    }
+
+    void deferDestroyPipeline(VkPipeline pipeline)
+    {
+        deletion_queue.defer([this, pipeline]() {
+            vkDestroyPipeline(device_, pipeline, nullptr);
+        });
+    }
+
+    void deferFree(Allocation allocation)
+    {
+        deletion_queue.defer([this, allocation]() mutable {
+            allocator->free(allocation);
+        });
+    }
+
+    void deferFree(DescriptorAllocator::Set set)
+    {
+        deletion_queue.defer([this, set]() mutable {
+            descriptor_allocator->free(set);
+        });
+    }
+
     VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
 
 private:
     void hasGflwRequiredInstanceExtensions()
@@ -337,7 +450,7 @@ private:
         for (const auto &required: requiredExtensions) {
             std::cout << "\t" << required << std::endl;
             if (available.find(required) == available.end()) {
-                throw std::runtime_error("Missing required glfw extension");
+                throw std::runtime_error("Missing required instance extension");
             }
         }
     }
@@ -354,7 +467,7 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = instanceVersion() >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -381,6 +494,23 @@ private:
         }
 
         hasGflwRequiredInstanceExtensions();
+        instance_version = appInfo.apiVersion;
+    }
+
+    // a 1.0 loader neither has vkEnumerateInstanceVersion nor accepts a newer apiVersion
+    static uint32_t instanceVersion()
+    {
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion")
+        );
+
+        uint32_t version = VK_API_VERSION_1_0;
+
+        if (enumerateInstanceVersion == nullptr || enumerateInstanceVersion(&version) != VK_SUCCESS) {
+            return VK_API_VERSION_1_0;
+        }
+
+        return version;
     }
 
     void setupDebugMessenger()
@@ -429,7 +559,7 @@ private:
         QueueFamilyIndices indices = findQueueFamilies(physical_device);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -441,18 +571,42 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physical_device, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        features = deviceFeatures;
+
+        std::vector<const char *> enabledExtensions = deviceExtensions;
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        descriptor_indexing = supportsDescriptorIndexing(physical_device);
+
+        if (descriptor_indexing) {
+            enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+            indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        }
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = descriptor_indexing ? &indexingFeatures : nullptr;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -469,6 +623,243 @@ private:
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+    }
+
+    void createAllocator()
+    {
+        allocator = std::make_unique<MemoryAllocator>(physical_device, device_);
+    }
+
+    void createDescriptorAllocator()
+    {
+        descriptor_allocator = std::make_unique<DescriptorAllocator>(device_);
+    }
+
+    // everything the bindless table relies on, queried through the 1.1 entry points so a 1.0
+    // instance or device simply goes without. the entry points are looked up rather than linked,
+    // a 1.0 loader does not export them
+    bool supportsDescriptorIndexing(VkPhysicalDevice device)
+    {
+        if (instance_version < VK_API_VERSION_1_1) {
+            return false;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+            return false;
+        }
+
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        bool extensionSupported = std::any_of(
+            availableExtensions.begin(),
+            availableExtensions.end(),
+            [](const auto &extension) {
+                return strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+            }
+        );
+
+        if (!extensionSupported) {
+            return false;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+
+        auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2")
+        );
+
+        if (getPhysicalDeviceFeatures2 == nullptr) {
+            return false;
+        }
+
+        getPhysicalDeviceFeatures2(device, &features2);
+
+        return indexingFeatures.runtimeDescriptorArray &&
+               indexingFeatures.descriptorBindingPartiallyBound &&
+               indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+               indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+               indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+    }
+
+    void createBindlessTable()
+    {
+        if (!descriptor_indexing) {
+            return;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &indexingProperties;
+
+        auto getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2")
+        );
+
+        getPhysicalDeviceProperties2(physical_device, &properties2);
+
+        // every stage sees the whole table, so the per-stage limits bind as well
+        uint32_t maxTextures = std::min({
+            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        });
+        uint32_t maxBuffers = std::min(
+            indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers
+        );
+
+        // the two arrays share the per-stage resource budget
+        uint32_t resources = indexingProperties.maxPerStageUpdateAfterBindResources;
+
+        maxBuffers = std::min(maxBuffers, std::min(BindlessTable::MAX_BUFFERS, resources / 4));
+        maxTextures = std::min(maxTextures, resources - maxBuffers);
+
+        bindless_table = std::make_unique<BindlessTable>(device_, deletion_queue, maxTextures, maxBuffers);
+    }
+
+    // prefixed to the driver blob so a cache from another GPU or driver update is never fed back
+    struct PipelineCacheFileHeader
+    {
+        uint32_t magic;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x4d504331;
+
+    PipelineCacheFileHeader pipelineCacheFileHeader(uint64_t dataSize)
+    {
+        PipelineCacheFileHeader header{};
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = dataSize;
+
+        return header;
+    }
+
+    std::vector<char> loadPipelineCacheData()
+    {
+        std::ifstream file{pipelineCachePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            return {};
+        }
+
+        uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        PipelineCacheFileHeader header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+        PipelineCacheFileHeader expected = pipelineCacheFileHeader(header.dataSize);
+        if (!file || memcmp(&header, &expected, sizeof(header)) != 0 ||
+            header.dataSize != fileSize - sizeof(header)) {
+            std::cout << "pipeline cache: discarding stale " << pipelineCachePath.string() << std::endl;
+            return {};
+        }
+
+        std::vector<char> data(header.dataSize);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            return {};
+        }
+
+        return data;
+    }
+
+    void createPipelineCache()
+    {
+        std::vector<char> data = loadPipelineCacheData();
+
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipeline_cache) != VK_SUCCESS) {
+            // drivers may reject a blob they consider corrupt, start empty instead
+            cacheInfo.initialDataSize = 0;
+            cacheInfo.pInitialData = nullptr;
+
+            if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipeline_cache) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+        }
+    }
+
+    // per user rather than per working directory, so launching from elsewhere finds the same cache.
+    // falls back to the working directory when there is no home to put it in
+    static std::filesystem::path defaultPipelineCachePath()
+    {
+        std::filesystem::path directory;
+
+        if (const char *cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome != nullptr && *cacheHome != '\0') {
+            directory = cacheHome;
+        } else if (const char *home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+            directory = std::filesystem::path{home} / ".cache";
+        } else {
+            return "pipeline_cache.bin";
+        }
+
+        return directory / "mellianclient" / "pipeline_cache.bin";
+    }
+
+    // written to a temporary file and renamed over the old one so a crash never leaves half a cache
+    void savePipelineCache()
+    {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device_, pipeline_cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device_, pipeline_cache, &dataSize, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        PipelineCacheFileHeader header = pipelineCacheFileHeader(dataSize);
+        std::string temporaryPath = pipelineCachePath.string() + ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(pipelineCachePath.parent_path(), error);
+
+        {
+            std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(data.data(), static_cast<std::streamsize>(dataSize));
+
+            if (!file) {
+                std::cerr << "pipeline cache: failed to write " << temporaryPath << std::endl;
+                return;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, pipelineCachePath, error);
+        if (error) {
+            std::cerr << "pipeline cache: failed to replace " << pipelineCachePath.string() << ": " << error.message() << std::endl;
+        }
     }
 
     void createCommandPool()
@@ -484,6 +875,12 @@ private:
         if (vkCreateCommandPool(device_, &poolInfo, nullptr, &command_pool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
         }
+
+        poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+
+        if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transfer_command_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create transfer command pool!");
+        }
     }
 
     bool checkDeviceExtensionSupport(VkPhysicalDevice device)
@@ -555,11 +952,7 @@ private:
 
     std::vector<const char *> getRequiredExtensions()
     {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char *> extensions = window.getRequiredInstanceExtensions();
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -606,23 +999,33 @@ private:
 
         int i = 0;
         for (const auto &queueFamily: queueFamilies) {
-            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (!indices.graphicsFamilyHasValue && queueFamily.queueCount > 0 &&
+                queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-            if (queueFamily.queueCount > 0 && presentSupport) {
+            if (!indices.presentFamilyHasValue && queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
             }
-            if (indices.isComplete()) {
-                break;
+            // dedicated DMA queues advertise transfer without graphics or compute
+            if (!indices.transferFamilyHasValue && queueFamily.queueCount > 0 &&
+                (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = i;
+                indices.transferFamilyHasValue = true;
             }
 
             i++;
         }
 
+        if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+            indices.transferFamily = indices.graphicsFamily;
+            indices.transferFamilyHasValue = true;
+        }
+
         return indices;
     }
 
@@ -644,12 +1047,22 @@ private:
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     Window &window;
     VkCommandPool command_pool;
+    VkCommandPool transfer_command_pool;
+    VkPipelineCache pipeline_cache;
+    std::unique_ptr<MemoryAllocator> allocator;
+    std::unique_ptr<DescriptorAllocator> descriptor_allocator;
+    DeletionQueue deletion_queue;
+    std::unique_ptr<BindlessTable> bindless_table;
+    uint32_t instance_version = VK_API_VERSION_1_0;
+    bool descriptor_indexing = false;
 
     VkDevice device_;
     VkSurfaceKHR surface_;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue transferQueue_;
 
+    const std::filesystem::path pipelineCachePath = defaultPipelineCachePath();
     const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
     const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
@@ -0,0 +1,262 @@
+#ifndef MELLIANCLIENT_ENTITYSTORE_H
+#define MELLIANCLIENT_ENTITYSTORE_H
+
+#include <cassert>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
+#include <vector>
+#include "Model.h"
+
+struct Transform2dComponent
+{
+    glm::vec2 translation{};
+    glm::vec2 scale{1.f, 1.f};
+    float rotation = 0.f;
+
+    glm::mat2 mat2() const
+    {
+        const float s = glm::sin(rotation);
+        const float c = glm::cos(rotation);
+
+        glm::mat2 rotation_matrix{{c,  s},
+                                  {-s, c}};
+
+        glm::mat2 scale_matrix{
+            {scale.x, .0f},
+            {.0f,     scale.y}
+        };
+
+        return rotation_matrix * scale_matrix;
+    }
+};
+
+// Handle to an entity, the generation tells a live entity apart from an earlier one whose slot
+// has since been reused.
+struct Entity
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const Entity &other) const = default;
+};
+
+// Components live in dense parallel arrays, slot i of every array belongs to entities()[i], so
+// systems walk them linearly without touching the model refcounts. Handle slots map an entity to
+// its dense slot, destroying an entity moves the last dense slot into the hole and puts the handle
+// slot on a free list with its generation bumped, so create and destroy are both O(1).
+class EntityStore
+{
+public:
+    using ModelHandle = uint32_t;
+
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    EntityStore() = default;
+
+    EntityStore(const EntityStore &) = delete;
+
+    EntityStore &operator=(EntityStore &&) = delete;
+
+    ModelHandle addModel(std::shared_ptr<Model> model)
+    {
+        model_table.push_back(std::move(model));
+
+        return static_cast<ModelHandle>(model_table.size() - 1);
+    }
+
+    Model &getModel(ModelHandle handle) const
+    {
+        return *model_table[handle];
+    }
+
+    uint32_t modelCount() const
+    {
+        return static_cast<uint32_t>(model_table.size());
+    }
+
+    std::span<const std::shared_ptr<Model>> modelTable() const
+    {
+        return model_table;
+    }
+
+    // bumped by every create and destroy, anything indexed by dense slot is stale once it changed
+    uint64_t structureVersion() const
+    {
+        return structure_version;
+    }
+
+    Entity create(ModelHandle model, const Transform2dComponent &transform = {}, glm::vec3 color = {})
+    {
+        assert(model < model_table.size() && "unknown model handle");
+
+        Entity entity;
+
+        if (free_slot != INVALID_INDEX) {
+            entity = {free_slot, slots[free_slot].generation};
+            free_slot = slots[free_slot].next_free;
+        } else {
+            entity = {static_cast<uint32_t>(slots.size()), 0};
+            slots.push_back({});
+        }
+
+        slots[entity.index].dense = size();
+
+        dense_entities.push_back(entity);
+        translation_components.push_back(transform.translation);
+        scale_components.push_back(transform.scale);
+        rotation_components.push_back(transform.rotation);
+        color_components.push_back(color);
+        model_components.push_back(model);
+        structure_version++;
+
+        return entity;
+    }
+
+    // returns false when the entity is already gone, a stale handle never touches the slot's new owner
+    bool destroy(Entity entity)
+    {
+        if (!contains(entity)) {
+            return false;
+        }
+
+        uint32_t index = slots[entity.index].dense;
+        uint32_t last = size() - 1;
+
+        if (index != last) {
+            dense_entities[index] = dense_entities[last];
+            translation_components[index] = translation_components[last];
+            scale_components[index] = scale_components[last];
+            rotation_components[index] = rotation_components[last];
+            color_components[index] = color_components[last];
+            model_components[index] = model_components[last];
+
+            slots[dense_entities[index].index].dense = index;
+        }
+
+        dense_entities.pop_back();
+        translation_components.pop_back();
+        scale_components.pop_back();
+        rotation_components.pop_back();
+        color_components.pop_back();
+        model_components.pop_back();
+
+        auto &slot = slots[entity.index];
+
+        slot.dense = INVALID_INDEX;
+        slot.generation++;
+        slot.next_free = free_slot;
+        free_slot = entity.index;
+        structure_version++;
+
+        return true;
+    }
+
+    bool contains(Entity entity) const
+    {
+        return entity.index < slots.size() &&
+               slots[entity.index].generation == entity.generation &&
+               slots[entity.index].dense != INVALID_INDEX;
+    }
+
+    uint32_t indexOf(Entity entity) const
+    {
+        assert(contains(entity) && "entity does not exist");
+
+        return slots[entity.index].dense;
+    }
+
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(dense_entities.size());
+    }
+
+    void reserve(uint32_t count)
+    {
+        dense_entities.reserve(count);
+        translation_components.reserve(count);
+        scale_components.reserve(count);
+        rotation_components.reserve(count);
+        color_components.reserve(count);
+        model_components.reserve(count);
+    }
+
+    std::span<const Entity> entities() const
+    {
+        return dense_entities;
+    }
+
+    std::span<glm::vec2> translations()
+    {
+        return translation_components;
+    }
+
+    std::span<const glm::vec2> translations() const
+    {
+        return translation_components;
+    }
+
+    std::span<glm::vec2> scales()
+    {
+        return scale_components;
+    }
+
+    std::span<const glm::vec2> scales() const
+    {
+        return scale_components;
+    }
+
+    std::span<float> rotations()
+    {
+        return rotation_components;
+    }
+
+    std::span<const float> rotations() const
+    {
+        return rotation_components;
+    }
+
+    std::span<glm::vec3> colors()
+    {
+        return color_components;
+    }
+
+    std::span<const glm::vec3> colors() const
+    {
+        return color_components;
+    }
+
+    std::span<const ModelHandle> models() const
+    {
+        return model_components;
+    }
+
+    void setModel(Entity entity, ModelHandle model)
+    {
+        assert(model < model_table.size() && "unknown model handle");
+
+        model_components[indexOf(entity)] = model;
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t dense = INVALID_INDEX;
+        uint32_t generation = 0;
+        uint32_t next_free = INVALID_INDEX;
+    };
+
+    std::vector<std::shared_ptr<Model>> model_table;
+    std::vector<Slot> slots;
+    uint32_t free_slot = INVALID_INDEX;
+    uint64_t structure_version = 0;
+    std::vector<Entity> dense_entities;
+    std::vector<glm::vec2> translation_components;
+    std::vector<glm::vec2> scale_components;
+    std::vector<float> rotation_components;
+    std::vector<glm::vec3> color_components;
+    std::vector<ModelHandle> model_components;
+};
+
+#endif //MELLIANCLIENT_ENTITYSTORE_H
@@ -0,0 +1,161 @@
+#ifndef MELLIANCLIENT_FRAMEARENA_H
+#define MELLIANCLIENT_FRAMEARENA_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for CPU-side data that only lives while one frame is recorded. Allocating is a
+// pointer increment, individual frees are no-ops and reset releases everything at once. When a
+// frame outgrows the arena it chains extra blocks, and the next reset replaces them with a single
+// block large enough for the whole frame, so after a few frames it never touches the heap again.
+//
+// Nothing allocated from an arena may be used after its reset, and objects in it are never
+// destroyed, so only trivially destructible data belongs here.
+class FrameArena
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 256 * 1024;
+
+    explicit FrameArena(size_t capacity = DEFAULT_CAPACITY)
+    {
+        blocks.push_back(makeBlock(capacity));
+    }
+
+    FrameArena(const FrameArena &) = delete;
+
+    FrameArena &operator=(FrameArena &&) = delete;
+
+    void *allocate(size_t size, size_t alignment)
+    {
+        assert((alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+
+        size_t offset = alignedOffset(blocks.back(), used, alignment);
+
+        if (offset + size > blocks.back().size) {
+            chained += blocks.back().size;
+            blocks.push_back(makeBlock(std::max(size + alignment, blocks.back().size * 2)));
+            offset = alignedOffset(blocks.back(), 0, alignment);
+        }
+
+        used = offset + size;
+        peak = std::max(peak, chained + used);
+
+        return blocks.back().data.get() + offset;
+    }
+
+    template<typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is released without destructors");
+
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void reset()
+    {
+        if (blocks.size() > 1) {
+            size_t capacity = peak;
+
+            blocks.clear();
+            blocks.push_back(makeBlock(capacity));
+        }
+
+        used = 0;
+        chained = 0;
+        peak = 0;
+    }
+
+    size_t capacity() const
+    {
+        size_t total = 0;
+
+        for (const auto &block: blocks) {
+            total += block.size;
+        }
+
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    // bytes used in the current block, and the sizes of the blocks chained before it
+    size_t used = 0;
+    size_t chained = 0;
+    size_t peak = 0;
+
+    static Block makeBlock(size_t size)
+    {
+        return {std::make_unique<std::byte[]>(size), size};
+    }
+
+    static size_t alignedOffset(const Block &block, size_t offset, size_t alignment)
+    {
+        auto address = reinterpret_cast<uintptr_t>(block.data.get()) + offset;
+
+        return offset + ((alignment - address % alignment) % alignment);
+    }
+};
+
+// std allocator over a frame arena, containers using it must be dropped or reassigned before the
+// arena resets. moving a container moves its arena along with it
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    // a default constructed allocator only exists so containers can be declared before an arena is at
+    // hand, it must be replaced by assigning a container that has one before allocating
+    ArenaAllocator() noexcept = default;
+
+    ArenaAllocator(FrameArena &arena) noexcept : arena{&arena}
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena{other.arena}
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        assert(arena != nullptr && "allocator has no arena");
+
+        return arena->allocate<T>(count);
+    }
+
+    void deallocate(T *, size_t) noexcept
+    {
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept
+    {
+        return arena == other.arena;
+    }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+
+    FrameArena *arena = nullptr;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif //MELLIANCLIENT_FRAMEARENA_H
@@ -0,0 +1,109 @@
+#ifndef MELLIANCLIENT_FRAMEQUEUE_H
+#define MELLIANCLIENT_FRAMEQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+// Bounded lock-free queue in the style of Vyukov's array queue: every cell carries a sequence
+// number that tells producers and consumers whose turn it is, so neither side ever blocks. One
+// thread produces and one consumes, but the producer may also pop, which is how pushDropOldest
+// makes room when the consumer has fallen behind.
+template<typename T, size_t CAPACITY>
+class FrameQueue
+{
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+    FrameQueue()
+    {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    FrameQueue(const FrameQueue &) = delete;
+
+    FrameQueue &operator=(FrameQueue &&) = delete;
+
+    bool tryPush(T value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto &cell = cells[position & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> tryPop()
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+
+        while (true) {
+            auto &cell = cells[position & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+            if (difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    T value = std::move(cell.value);
+
+                    cell.sequence.store(position + CAPACITY, std::memory_order_release);
+
+                    return value;
+                }
+            } else if (difference < 0) {
+                return std::nullopt;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // when the queue is full the oldest entry is taken out and returned so its owner can recycle it
+    std::optional<T> pushDropOldest(T value)
+    {
+        std::optional<T> dropped;
+
+        while (!tryPush(value)) {
+            if (auto oldest = tryPop()) {
+                dropped = std::move(oldest);
+            }
+        }
+
+        return dropped;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value{};
+    };
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::array<Cell, CAPACITY> cells;
+    alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+    alignas(CACHE_LINE) std::atomic<size_t> head{0};
+};
+
+#endif //MELLIANCLIENT_FRAMEQUEUE_H
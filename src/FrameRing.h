@@ -0,0 +1,193 @@
+#ifndef MELLIANCLIENT_FRAMERING_H
+#define MELLIANCLIENT_FRAMERING_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include "Device.h"
+
+// Persistently mapped, host-visible buffer per frame slot that is filled front to back while a frame
+// is recorded and rewound when the slot comes around again, so uniform, storage, vertex and indirect
+// data written every frame never needs a buffer of its own. Allocations return the buffer and an
+// offset into it, which goes straight into vkCmdBindDescriptorSets as a dynamic offset or into the
+// offset parameter of vertex buffer and indirect commands.
+//
+// A frame that outgrows its slot chains another, larger block instead of failing. When the slot
+// comes around again its blocks are merged into one buffer of their combined size, so a steady
+// workload settles on a single buffer per slot. Allocations that have to share a buffer, such as
+// everything behind one descriptor set, are preceded by reserve, which moves to a new block up front
+// when the rest of the current one is too small. Users holding descriptors that point at the ring
+// compare buffer() against the one they wrote.
+class FrameRing
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_CAPACITY = 256 * 1024;
+
+    static constexpr VkBufferUsageFlags USAGE = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+    struct Slice
+    {
+        VkBuffer buffer;
+        void *data;
+        VkDeviceSize offset;
+    };
+
+    FrameRing(Device &device, uint32_t frames_in_flight, VkDeviceSize capacity = DEFAULT_CAPACITY)
+        : device{device}, slots(frames_in_flight)
+    {
+        const auto &limits = device.properties.limits;
+
+        uniform_alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+        storage_alignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
+
+        for (auto &slot: slots) {
+            addBlock(slot, capacity);
+        }
+    }
+
+    ~FrameRing()
+    {
+        for (auto &slot: slots) {
+            for (auto &block: slot.blocks) {
+                device.destroyBuffer(block.buffer, block.allocation);
+            }
+        }
+    }
+
+    FrameRing(const FrameRing &) = delete;
+
+    FrameRing &operator=(FrameRing &&) = delete;
+
+    // the fence of this frame slot must have been waited on
+    void beginFrame(uint32_t frame_index)
+    {
+        current = &slots[frame_index];
+
+        if (current->blocks.size() > 1) {
+            VkDeviceSize capacity = 0;
+
+            // descriptors may still be written against the old buffers by a user that has not
+            // noticed the swap yet, so they go through the deletion queue
+            for (auto &block: current->blocks) {
+                capacity += block.capacity;
+                device.deferDestroyBuffer(block.buffer, block.allocation);
+            }
+
+            current->blocks.clear();
+            addBlock(*current, capacity);
+        }
+
+        current->blocks.back().used = 0;
+    }
+
+    // makes sure the next size bytes, worst case alignment padding included, land in one buffer
+    void reserve(VkDeviceSize size)
+    {
+        assert(current != nullptr && "cannot reserve outside of a frame");
+
+        auto &block = current->blocks.back();
+
+        if (block.used + size > block.capacity) {
+            addBlock(*current, size);
+        }
+    }
+
+    Slice allocate(VkDeviceSize size, VkDeviceSize alignment)
+    {
+        assert(current != nullptr && "cannot allocate outside of a frame");
+        assert((alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+
+        VkDeviceSize offset = (current->blocks.back().used + alignment - 1) & ~(alignment - 1);
+
+        if (offset + size > current->blocks.back().capacity) {
+            addBlock(*current, size);
+            offset = 0;
+        }
+
+        auto &block = current->blocks.back();
+
+        block.used = offset + size;
+
+        return {block.buffer, static_cast<char *>(block.allocation.mapped) + offset, offset};
+    }
+
+    // copies value into the ring, the returned offset is used as the dynamic offset of a uniform buffer
+    template<typename T>
+    VkDeviceSize pushUniform(const T &value)
+    {
+        auto slice = allocate(sizeof(T), uniform_alignment);
+
+        std::memcpy(slice.data, &value, sizeof(T));
+
+        return slice.offset;
+    }
+
+    template<typename T>
+    Slice allocateStorage(size_t count)
+    {
+        return allocate(count * sizeof(T), std::max<VkDeviceSize>(storage_alignment, alignof(T)));
+    }
+
+    // upper bound on the padding a single allocation adds, for sizing reserve
+    VkDeviceSize maxAlignment() const
+    {
+        return std::max(uniform_alignment, storage_alignment);
+    }
+
+    // the buffer the next allocation goes to unless it has to chain a new block
+    VkBuffer buffer() const
+    {
+        assert(current != nullptr && "cannot get buffer outside of a frame");
+
+        return current->blocks.back().buffer;
+    }
+
+private:
+    struct Block
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation allocation{};
+        VkDeviceSize capacity = 0;
+        VkDeviceSize used = 0;
+    };
+
+    // blocks of a frame are chained in order, only the last one is being filled
+    struct Slot
+    {
+        std::vector<Block> blocks;
+    };
+
+    Device &device;
+    std::vector<Slot> slots;
+    Slot *current = nullptr;
+    VkDeviceSize uniform_alignment;
+    VkDeviceSize storage_alignment;
+
+    // a chained block at least doubles the last one, blocks start at offset 0 so they need no padding
+    void addBlock(Slot &slot, VkDeviceSize min_capacity)
+    {
+        Block block{};
+
+        block.capacity = slot.blocks.empty() ? min_capacity : slot.blocks.back().capacity * 2;
+
+        while (block.capacity < min_capacity) {
+            block.capacity *= 2;
+        }
+
+        device.createBuffer(
+            block.capacity,
+            USAGE,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            block.buffer,
+            block.allocation
+        );
+
+        slot.blocks.push_back(block);
+    }
+};
+
+#endif //MELLIANCLIENT_FRAMERING_H
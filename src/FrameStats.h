@@ -0,0 +1,179 @@
+#ifndef MELLIANCLIENT_FRAMESTATS_H
+#define MELLIANCLIENT_FRAMESTATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-frame timings collected by the benchmark mode, the first warmup frames are dropped so
+// pipeline compiles and first uploads do not skew the result.
+class FrameStats
+{
+public:
+    struct Sample
+    {
+        double frame_ms;
+        double acquire_ms;
+        double record_ms;
+        double submit_ms;
+        double present_ms;
+        double gpu_ms;
+        // from polling the input the frame was simulated from until present returned, the display
+        // adds its own scanout delay on top which the CPU cannot observe
+        double latency_ms;
+        // heap allocations the render thread made for this frame, negative when not counted
+        double render_allocations;
+        // heap allocations any thread made while the render thread worked on this frame: the workers
+        // recording it, but also the main thread simulating the next one
+        double all_allocations;
+    };
+
+    struct Info
+    {
+        std::string device;
+        uint32_t objects;
+        uint32_t models;
+        std::string record_mode;
+        uint32_t frames_in_flight;
+        std::string present_mode;
+        uint32_t image_count;
+        bool low_latency;
+    };
+
+    FrameStats(uint32_t warmup_frames) : warmup_frames{warmup_frames}
+    {
+    }
+
+    void reserve(size_t frames)
+    {
+        samples.reserve(frames);
+    }
+
+    void add(const Sample &sample)
+    {
+        if (seen_frames++ < warmup_frames) {
+            return;
+        }
+
+        samples.push_back(sample);
+    }
+
+    void writeJson(std::ostream &out, const Info &info) const
+    {
+        out << "{\n";
+        out << "  \"device\": \"" << escape(info.device) << "\",\n";
+        out << "  \"scene\": {\"objects\": " << info.objects << ", \"models\": " << info.models << "},\n";
+        out << "  \"record_mode\": \"" << escape(info.record_mode) << "\",\n";
+        out << "  \"swap_chain\": {\"frames_in_flight\": " << info.frames_in_flight
+            << ", \"present_mode\": \"" << escape(info.present_mode) << "\""
+            << ", \"images\": " << info.image_count
+            << ", \"low_latency\": " << (info.low_latency ? "true" : "false") << "},\n";
+        out << "  \"warmup_frames\": " << warmup_frames << ",\n";
+        out << "  \"frames\": " << samples.size() << ",\n";
+        out << "  \"cpu\": {\n";
+        writeSummary(out, "frame_ms", &Sample::frame_ms, ",");
+        writeSummary(out, "acquire_ms", &Sample::acquire_ms, ",");
+        writeSummary(out, "record_ms", &Sample::record_ms, ",");
+        writeSummary(out, "submit_ms", &Sample::submit_ms, ",");
+        writeSummary(out, "present_ms", &Sample::present_ms, ",");
+        writeSummary(out, "latency_ms", &Sample::latency_ms, "");
+        out << "  },\n";
+
+        // negative gpu times mark frames without timestamp results
+        bool has_gpu = std::any_of(samples.begin(), samples.end(), [](const Sample &sample) {
+            return sample.gpu_ms >= 0.;
+        });
+
+        if (has_gpu) {
+            out << "  \"gpu\": {\n";
+            writeSummary(out, "frame_ms", &Sample::gpu_ms, "");
+            out << "  },\n";
+        } else {
+            out << "  \"gpu\": null,\n";
+        }
+
+        bool has_allocations = std::any_of(samples.begin(), samples.end(), [](const Sample &sample) {
+            return sample.render_allocations >= 0.;
+        });
+
+        if (has_allocations) {
+            out << "  \"allocations\": {\n";
+            writeSummary(out, "render_thread_per_frame", &Sample::render_allocations, ",");
+            writeSummary(out, "all_threads_per_frame", &Sample::all_allocations, "");
+            out << "  }\n";
+        } else {
+            out << "  \"allocations\": null\n";
+        }
+
+        out << "}\n";
+    }
+
+private:
+    uint32_t warmup_frames;
+    uint32_t seen_frames = 0;
+    std::vector<Sample> samples;
+
+    void writeSummary(std::ostream &out, const char *name, double Sample::*field, const char *separator) const
+    {
+        std::vector<double> values;
+
+        for (const auto &sample: samples) {
+            if (sample.*field >= 0.) {
+                values.push_back(sample.*field);
+            }
+        }
+
+        std::sort(values.begin(), values.end());
+
+        double mean = 0.;
+
+        for (double value: values) {
+            mean += value;
+        }
+
+        if (!values.empty()) {
+            mean /= static_cast<double>(values.size());
+        }
+
+        out << "    \"" << name << "\": {"
+            << "\"mean\": " << mean
+            << ", \"min\": " << percentile(values, 0.)
+            << ", \"p50\": " << percentile(values, .5)
+            << ", \"p90\": " << percentile(values, .9)
+            << ", \"p99\": " << percentile(values, .99)
+            << ", \"max\": " << percentile(values, 1.)
+            << "}" << separator << "\n";
+    }
+
+    // nearest rank on sorted values
+    static double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        if (sorted.empty()) {
+            return 0.;
+        }
+
+        auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    static std::string escape(const std::string &text)
+    {
+        std::string escaped;
+
+        for (char c: text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+
+            escaped += c;
+        }
+
+        return escaped;
+    }
+};
+
+#endif //MELLIANCLIENT_FRAMESTATS_H
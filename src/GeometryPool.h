@@ -0,0 +1,160 @@
+#ifndef MELLIANCLIENT_GEOMETRYPOOL_H
+#define MELLIANCLIENT_GEOMETRYPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "Device.h"
+#include "MemoryAllocator.h"
+#include "UploadQueue.h"
+
+// Packs the vertices of many models into a few large device local vertex buffers (pages) so that
+// everything living in one page can be drawn by a single indirect draw without rebinding.
+class GeometryPool
+{
+public:
+    static constexpr uint32_t PAGE_VERTEX_CAPACITY = 1024 * 1024;
+
+    struct Range
+    {
+        uint32_t page = 0;
+        uint32_t first_vertex = 0;
+        uint32_t vertex_count = 0;
+        UploadTicket ticket = 0;
+    };
+
+    GeometryPool(Device &device, UploadQueue &upload_queue, VkDeviceSize vertex_stride)
+        : device{device}, upload_queue{upload_queue}, vertex_stride{vertex_stride}
+    {
+    }
+
+    // frees still queued keep the pages alive through their own reference, the buffers go with
+    // the final flush of the device
+    ~GeometryPool()
+    {
+        std::lock_guard<std::mutex> lock{pages->mutex};
+
+        for (auto &page: pages->list) {
+            device.deferDestroyBuffer(page.buffer, page.allocation);
+        }
+    }
+
+    GeometryPool(const GeometryPool &) = delete;
+
+    GeometryPool &operator=(GeometryPool &&) = delete;
+
+    Range allocate(const void *vertices, uint32_t vertex_count)
+    {
+        if (vertex_count > PAGE_VERTEX_CAPACITY) {
+            throw std::runtime_error("failed to allocate geometry: mesh is larger than a geometry page");
+        }
+
+        Range range{};
+        VkDeviceSize offset;
+
+        range.vertex_count = vertex_count;
+
+        std::unique_lock<std::mutex> lock{pages->mutex};
+        auto &list = pages->list;
+
+        for (range.page = 0; range.page < list.size(); range.page++) {
+            if (list[range.page].ranges->allocate(vertex_count * vertex_stride, vertex_stride, offset)) {
+                break;
+            }
+        }
+
+        if (range.page == list.size()) {
+            createPage();
+            list.back().ranges->allocate(vertex_count * vertex_stride, vertex_stride, offset);
+        }
+
+        range.first_vertex = static_cast<uint32_t>(offset / vertex_stride);
+
+        // a page created by another thread may move the list once the lock is gone
+        VkBuffer buffer = list[range.page].buffer;
+
+        lock.unlock();
+
+        range.ticket = upload_queue.enqueueBuffer(
+            buffer,
+            offset,
+            vertices,
+            vertex_count * vertex_stride
+        );
+
+        return range;
+    }
+
+    // frames in flight may still draw from the range, so it only becomes reusable once they finished
+    void free(const Range &range)
+    {
+        device.deletionQueue().defer([pages = pages, range, vertex_stride = vertex_stride]() {
+            std::lock_guard<std::mutex> lock{pages->mutex};
+
+            pages->list[range.page].ranges->free(range.first_vertex * vertex_stride);
+        });
+    }
+
+    bool isUploaded(const Range &range) const
+    {
+        return upload_queue.isComplete(range.ticket);
+    }
+
+    VkBuffer getBuffer(uint32_t page) const
+    {
+        std::lock_guard<std::mutex> lock{pages->mutex};
+
+        return pages->list[page].buffer;
+    }
+
+    size_t pageCount() const
+    {
+        std::lock_guard<std::mutex> lock{pages->mutex};
+
+        return pages->list.size();
+    }
+
+private:
+    struct Page
+    {
+        VkBuffer buffer;
+        Allocation allocation;
+        std::unique_ptr<MemoryBlock> ranges;
+    };
+
+    // models are created on the main thread while the render thread binds pages and runs the
+    // deferred frees, which may only get to run after the pool itself is gone
+    struct Pages
+    {
+        std::mutex mutex;
+        std::vector<Page> list;
+    };
+
+    Device &device;
+    UploadQueue &upload_queue;
+    VkDeviceSize vertex_stride;
+    std::shared_ptr<Pages> pages = std::make_shared<Pages>();
+
+    void createPage()
+    {
+        Page page{};
+        VkDeviceSize size = PAGE_VERTEX_CAPACITY * vertex_stride;
+
+        device.createBuffer(
+            size,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            page.buffer,
+            page.allocation
+        );
+
+        // the block only tracks offsets inside the page, it owns no memory of its own
+        page.ranges = std::make_unique<MemoryBlock>(size);
+
+        pages->list.push_back(std::move(page));
+    }
+};
+
+#endif //MELLIANCLIENT_GEOMETRYPOOL_H
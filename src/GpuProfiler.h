@@ -0,0 +1,298 @@
+#ifndef MELLIANCLIENT_GPUPROFILER_H
+#define MELLIANCLIENT_GPUPROFILER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Device.h"
+
+// Named GPU timestamp scopes on primary command buffers. Every frame in flight owns a query pool,
+// its results are read when the same frame index comes around again, after the renderer waited on
+// that frame's fence, so resolving never stalls. Scopes may nest but must be written outside of
+// render passes begun with secondary command buffer contents.
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t MAX_SCOPES = 64;
+    static constexpr uint32_t ROLLING_FRAMES = 120;
+    static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    using ScopeId = uint32_t;
+
+    static constexpr ScopeId NO_SCOPE = UINT32_MAX;
+
+    struct ScopeStats
+    {
+        double last_ms;
+        double average_ms;
+        double max_ms;
+    };
+
+    GpuProfiler(Device &device, uint32_t frames_in_flight) : device{device}, frames(frames_in_flight)
+    {
+        if (!device.properties.limits.timestampComputeAndGraphics) {
+            return;
+        }
+
+        uint32_t family_count = 0;
+
+        vkGetPhysicalDeviceQueueFamilyProperties(device.physicalDevice(), &family_count, nullptr);
+
+        std::vector<VkQueueFamilyProperties> families(family_count);
+
+        vkGetPhysicalDeviceQueueFamilyProperties(device.physicalDevice(), &family_count, families.data());
+
+        uint32_t valid_bits = families[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+
+        if (valid_bits == 0) {
+            return;
+        }
+
+        timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+        VkQueryPoolCreateInfo pool_info{};
+
+        pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = MAX_SCOPES * 2;
+
+        for (auto &frame: frames) {
+            if (vkCreateQueryPool(device.device(), &pool_info, nullptr, &frame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool");
+            }
+        }
+    }
+
+    ~GpuProfiler()
+    {
+        for (auto &frame: frames) {
+            if (frame.pool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(device.device(), frame.pool, nullptr);
+            }
+        }
+    }
+
+    GpuProfiler(const GpuProfiler &) = delete;
+
+    GpuProfiler &operator=(GpuProfiler &&) = delete;
+
+    bool isEnabled() const
+    {
+        return frames[0].pool != VK_NULL_HANDLE;
+    }
+
+    // resolves what this frame index recorded last time and resets its pool, call right after the
+    // frame's fence was waited on and its command buffer begun
+    void beginFrame(VkCommandBuffer command_buffer, uint32_t frame_index)
+    {
+        if (!isEnabled()) {
+            return;
+        }
+
+        current = &frames[frame_index];
+
+        resolve(*current);
+
+        current->scopes.clear();
+        current->depth = 0;
+
+        vkCmdResetQueryPool(command_buffer, current->pool, 0, MAX_SCOPES * 2);
+    }
+
+    // the name must outlive the profiler, string literals are the intended use
+    ScopeId beginScope(VkCommandBuffer command_buffer, const char *name)
+    {
+        if (current == nullptr || current->scopes.size() == MAX_SCOPES) {
+            return NO_SCOPE;
+        }
+
+        auto scope = static_cast<ScopeId>(current->scopes.size());
+
+        current->scopes.push_back({name, current->depth++, false});
+
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current->pool, scope * 2);
+
+        return scope;
+    }
+
+    void endScope(VkCommandBuffer command_buffer, ScopeId scope)
+    {
+        if (scope == NO_SCOPE) {
+            return;
+        }
+
+        current->scopes[scope].closed = true;
+        current->depth--;
+
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current->pool, scope * 2 + 1);
+    }
+
+    // latest resolved value and average over the last ROLLING_FRAMES resolves, negative when unknown
+    double lastMs(const std::string &name) const
+    {
+        auto found = rolling.find(name);
+
+        return found == rolling.end() ? -1. : found->second.last_ms;
+    }
+
+    std::map<std::string, ScopeStats> getStats() const
+    {
+        std::map<std::string, ScopeStats> stats;
+
+        for (const auto &[name, scope]: rolling) {
+            double sum = 0.;
+            double max = 0.;
+
+            for (uint32_t i = 0; i < scope.count; i++) {
+                sum += scope.samples[i];
+                max = std::max(max, scope.samples[i]);
+            }
+
+            stats[name] = {scope.last_ms, scope.count > 0 ? sum / scope.count : 0., max};
+        }
+
+        return stats;
+    }
+
+    void printSummary(std::ostream &out) const
+    {
+        auto flags = out.flags();
+        auto precision = out.precision();
+
+        out << "gpu scopes (last " << ROLLING_FRAMES << " frames):" << std::endl;
+
+        for (const auto &[name, stats]: getStats()) {
+            out << "\t" << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+                << " avg " << stats.average_ms << " ms, max " << stats.max_ms << " ms" << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    void setTracing(bool enabled)
+    {
+        tracing = enabled;
+    }
+
+    // chrome://tracing / Perfetto JSON, nesting depth becomes the track
+    void writeTrace(const std::string &path) const
+    {
+        std::ofstream file{path};
+
+        if (!file) {
+            throw std::runtime_error("failed to open trace output: " + path);
+        }
+
+        file << "{\"traceEvents\": [\n";
+
+        for (size_t i = 0; i < trace_events.size(); i++) {
+            const auto &event = trace_events[i];
+
+            file << "  {\"name\": \"" << event.name << "\", \"cat\": \"gpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                 << event.depth << ", \"ts\": " << std::fixed << std::setprecision(3) << event.start_us
+                 << ", \"dur\": " << event.duration_us << "}" << (i + 1 < trace_events.size() ? "," : "") << "\n";
+        }
+
+        file << "]}\n";
+    }
+
+private:
+    struct Scope
+    {
+        const char *name;
+        uint32_t depth;
+        bool closed;
+    };
+
+    struct FrameQueries
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        std::vector<Scope> scopes;
+        uint32_t depth = 0;
+    };
+
+    struct RollingScope
+    {
+        std::array<double, ROLLING_FRAMES> samples{};
+        uint32_t count = 0;
+        uint32_t next = 0;
+        double last_ms = 0.;
+    };
+
+    struct TraceEvent
+    {
+        const char *name;
+        uint32_t depth;
+        double start_us;
+        double duration_us;
+    };
+
+    Device &device;
+    std::vector<FrameQueries> frames;
+    FrameQueries *current = nullptr;
+    uint64_t timestamp_mask = 0;
+    std::map<std::string, RollingScope> rolling;
+    bool tracing = false;
+    std::vector<TraceEvent> trace_events;
+    std::vector<uint64_t> ticks;
+
+    void resolve(FrameQueries &frame)
+    {
+        if (frame.scopes.empty()) {
+            return;
+        }
+
+        ticks.resize(frame.scopes.size() * 2);
+
+        // no WAIT bit, the frame fence already guarantees availability
+        auto result = vkGetQueryPoolResults(
+            device.device(),
+            frame.pool,
+            0,
+            static_cast<uint32_t>(ticks.size()),
+            ticks.size() * sizeof(uint64_t),
+            ticks.data(),
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT
+        );
+
+        if (result != VK_SUCCESS) {
+            return;
+        }
+
+        double period_ns = device.properties.limits.timestampPeriod;
+
+        for (size_t i = 0; i < frame.scopes.size(); i++) {
+            const auto &scope = frame.scopes[i];
+
+            if (!scope.closed) {
+                continue;
+            }
+
+            uint64_t begin = ticks[i * 2] & timestamp_mask;
+            uint64_t end = ticks[i * 2 + 1] & timestamp_mask;
+            double ms = static_cast<double>((end - begin) & timestamp_mask) * period_ns / 1e6;
+
+            auto &stats = rolling[scope.name];
+
+            stats.samples[stats.next] = ms;
+            stats.next = (stats.next + 1) % ROLLING_FRAMES;
+            stats.count = std::min(stats.count + 1, ROLLING_FRAMES);
+            stats.last_ms = ms;
+
+            if (tracing && trace_events.size() < MAX_TRACE_EVENTS) {
+                trace_events.push_back({scope.name, scope.depth, begin * period_ns / 1e3, ms * 1e3});
+            }
+        }
+    }
+};
+
+#endif //MELLIANCLIENT_GPUPROFILER_H
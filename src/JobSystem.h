@@ -0,0 +1,470 @@
+#ifndef MELLIANCLIENT_JOBSYSTEM_H
+#define MELLIANCLIENT_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Trace.h"
+
+// Counts the jobs submitted against it that have not finished yet. Jobs submitted with
+// JobSystem::submitAfter are held back until the counter they depend on drops to zero.
+// A counter must only be reused or destroyed after JobSystem::wait returned for it.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+
+    JobCounter(const JobCounter &) = delete;
+
+    JobCounter &operator=(JobCounter &&) = delete;
+
+    bool isDone() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    struct Continuation
+    {
+        std::function<void()> job;
+        JobCounter *counter;
+    };
+
+    std::atomic<uint32_t> pending{0};
+    std::mutex continuation_mutex;
+    std::vector<Continuation> continuations;
+};
+
+// Work-stealing scheduler. Every worker owns a job ring guarded by its own mutex, takes its own newest
+// job first and steals the oldest job of another worker when it runs dry, jobs submitted from a
+// worker land in its own ring. Jobs submitted with submitMain only ever run on the thread that created the system, which
+// is where GLFW has to be called from. Jobs must not throw.
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    // jobs each ring holds before it has to grow, far more than a frame keeps queued
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
+    static uint32_t defaultWorkerCount()
+    {
+        // hardware_concurrency may report 0 when it cannot tell
+        return std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    JobSystem(uint32_t worker_count = defaultWorkerCount()) : main_thread{std::this_thread::get_id()}
+    {
+        worker_count = std::max(1u, worker_count);
+
+        for (uint32_t i = 0; i < worker_count; i++) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+
+        for (uint32_t i = 0; i < worker_count; i++) {
+            workers.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    // drains everything already submitted to the workers before joining
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+
+            stopping = true;
+        }
+
+        sleep_condition.notify_all();
+
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    JobSystem(const JobSystem &) = delete;
+
+    JobSystem &operator=(JobSystem &&) = delete;
+
+    void submit(Job job, JobCounter *counter = nullptr)
+    {
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        enqueue({std::move(job), counter});
+    }
+
+    // runs the job once dependency is done, counter covers it from now on
+    void submitAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr)
+    {
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{dependency.continuation_mutex};
+
+            if (!dependency.isDone()) {
+                dependency.continuations.push_back({std::move(job), counter});
+
+                return;
+            }
+        }
+
+        enqueue({std::move(job), counter});
+    }
+
+    void submitMain(Job job, JobCounter *counter = nullptr)
+    {
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::lock_guard<std::mutex> lock{main_mutex};
+
+        main_jobs.pushBack({std::move(job), counter});
+    }
+
+    // called once per iteration of the main loop
+    void runMainThreadJobs()
+    {
+        assert(std::this_thread::get_id() == main_thread && "main thread jobs must run on the main thread");
+
+        while (runMainJob()) {
+        }
+    }
+
+    // a worker waiting from inside a job keeps running any job, so nested waits cannot starve the
+    // pool. other threads only help with jobs counted by this counter and then block, a render thread
+    // waiting on its recording jobs never picks up an unrelated pipeline compile. the main thread
+    // also keeps running main thread jobs, which may be what the counter is waiting for
+    void wait(JobCounter &counter)
+    {
+        bool on_worker = current_system == this;
+        bool on_main_thread = std::this_thread::get_id() == main_thread;
+        uint32_t home = on_worker ? current_worker : 0;
+
+        while (!counter.isDone()) {
+            if (on_worker) {
+                if (!runWorkerJob(home)) {
+                    std::this_thread::yield();
+                }
+
+                continue;
+            }
+
+            if (on_main_thread && runMainJob()) {
+                continue;
+            }
+
+            if (runWorkerJob(home, &counter)) {
+                continue;
+            }
+
+            uint32_t pending = counter.pending.load(std::memory_order_acquire);
+
+            if (pending == 0) {
+                break;
+            }
+
+            if (on_main_thread) {
+                std::this_thread::yield();
+            } else {
+                // woken by the job that drops the counter to zero
+                counter.pending.wait(pending, std::memory_order_acquire);
+            }
+        }
+
+        // the job that finished the counter may still hold its lock, after this it can be destroyed
+        std::lock_guard<std::mutex> lock{counter.continuation_mutex};
+    }
+
+    // splits [0, count) into ranges of at most grain and blocks until all of them have run. the body
+    // is only referenced, so the jobs stay small enough for std::function to keep them off the heap
+    template<typename Body>
+    void parallelFor(uint32_t count, uint32_t grain, const Body &body)
+    {
+        JobCounter counter;
+
+        grain = std::max(1u, grain);
+
+        for (uint32_t begin = grain; begin < count; begin += grain) {
+            submit([&body, begin, end = std::min(count, begin + grain)]() { body(begin, end); }, &counter);
+        }
+
+        body(0, std::min(count, grain));
+        wait(counter);
+    }
+
+    uint32_t workerCount() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+private:
+    struct QueuedJob
+    {
+        Job job;
+        JobCounter *counter;
+    };
+
+    // ring over storage reserved up front, unlike a deque it does not allocate as jobs flow through it.
+    // it only grows when more jobs are queued at once than it ever held before
+    class JobRing
+    {
+    public:
+        JobRing() : slots(QUEUE_CAPACITY)
+        {
+        }
+
+        bool empty() const
+        {
+            return count == 0;
+        }
+
+        void pushBack(QueuedJob job)
+        {
+            if (count == slots.size()) {
+                grow();
+            }
+
+            at(count++) = std::move(job);
+        }
+
+        QueuedJob popBack()
+        {
+            return std::move(at(--count));
+        }
+
+        QueuedJob popFront()
+        {
+            QueuedJob job = std::move(at(0));
+
+            head = (head + 1) % slots.size();
+            count--;
+
+            return job;
+        }
+
+        // takes the oldest job counted by counter, the ones behind it move up
+        bool takeCounted(const JobCounter &counter, QueuedJob &job)
+        {
+            for (size_t i = 0; i < count; i++) {
+                if (at(i).counter != &counter) {
+                    continue;
+                }
+
+                job = std::move(at(i));
+
+                for (size_t j = i + 1; j < count; j++) {
+                    at(j - 1) = std::move(at(j));
+                }
+
+                count--;
+
+                return true;
+            }
+
+            return false;
+        }
+
+    private:
+        std::vector<QueuedJob> slots;
+        size_t head = 0;
+        size_t count = 0;
+
+        QueuedJob &at(size_t i)
+        {
+            return slots[(head + i) % slots.size()];
+        }
+
+        void grow()
+        {
+            std::vector<QueuedJob> grown(slots.size() * 2);
+
+            for (size_t i = 0; i < count; i++) {
+                grown[i] = std::move(at(i));
+            }
+
+            slots.swap(grown);
+            head = 0;
+        }
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        JobRing jobs;
+    };
+
+    static inline thread_local const JobSystem *current_system = nullptr;
+    static inline thread_local uint32_t current_worker = 0;
+
+    std::thread::id main_thread;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<uint32_t> next_queue{0};
+    std::atomic<uint32_t> queued{0};
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+    bool stopping = false;
+    std::mutex main_mutex;
+    JobRing main_jobs;
+
+    void enqueue(QueuedJob job)
+    {
+        uint32_t queue = current_system == this
+                         ? current_worker
+                         : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+        // counted before it is visible, so a pop can never take the count below zero
+        queued.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock{queues[queue]->mutex};
+
+            queues[queue]->jobs.pushBack(std::move(job));
+        }
+
+        // taking the lock orders this against a worker that is about to sleep
+        {
+            std::lock_guard<std::mutex> lock{sleep_mutex};
+        }
+
+        sleep_condition.notify_one();
+    }
+
+    // with a counter only jobs counted by it are taken
+    bool runWorkerJob(uint32_t home, const JobCounter *only = nullptr)
+    {
+        QueuedJob job;
+
+        if (!(only == nullptr ? pop(home, job) : popCounted(*only, job))) {
+            return false;
+        }
+
+        run(job);
+
+        return true;
+    }
+
+    bool runMainJob()
+    {
+        QueuedJob job;
+
+        {
+            std::lock_guard<std::mutex> lock{main_mutex};
+
+            if (main_jobs.empty()) {
+                return false;
+            }
+
+            job = main_jobs.popFront();
+        }
+
+        run(job);
+
+        return true;
+    }
+
+    // own ring from the back, everyone else's from the front
+    bool pop(uint32_t home, QueuedJob &job)
+    {
+        for (uint32_t i = 0; i < queues.size(); i++) {
+            auto &queue = *queues[(home + i) % queues.size()];
+
+            std::lock_guard<std::mutex> lock{queue.mutex};
+
+            if (queue.jobs.empty()) {
+                continue;
+            }
+
+            job = i == 0 ? queue.jobs.popBack() : queue.jobs.popFront();
+
+            queued.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    bool popCounted(const JobCounter &counter, QueuedJob &job)
+    {
+        for (auto &queue: queues) {
+            std::lock_guard<std::mutex> lock{queue->mutex};
+
+            if (!queue->jobs.takeCounted(counter, job)) {
+                continue;
+            }
+
+            queued.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void run(QueuedJob &job)
+    {
+        job.job();
+
+        if (job.counter == nullptr) {
+            return;
+        }
+
+        std::vector<JobCounter::Continuation> continuations;
+
+        // the counter is not touched after this lock is released, see wait
+        {
+            std::lock_guard<std::mutex> lock{job.counter->continuation_mutex};
+
+            if (job.counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                continuations.swap(job.counter->continuations);
+                job.counter->pending.notify_all();
+            }
+        }
+
+        for (auto &continuation: continuations) {
+            enqueue({std::move(continuation.job), continuation.counter});
+        }
+    }
+
+    void work(uint32_t index)
+    {
+        current_system = this;
+        current_worker = index;
+
+        TRACE_THREAD_NAME("worker");
+
+        while (true) {
+            if (runWorkerJob(index)) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock{sleep_mutex};
+
+            sleep_condition.wait(lock, [this]() {
+                return stopping || queued.load(std::memory_order_acquire) > 0;
+            });
+
+            if (stopping && queued.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+};
+
+#endif //MELLIANCLIENT_JOBSYSTEM_H
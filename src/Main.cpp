@@ -1,13 +1,40 @@
 #include <cstdlib>
 #include <iostream>
+#include <new>
 #include <stdexcept>
+#include "AllocationCounter.h"
 #include "App.h"
+#include "Options.h"
 
-int main()
+#ifdef MELLIANCLIENT_COUNT_ALLOCATIONS
+// the array and nothrow forms forward here, the aligned forms keep their own allocation path
+void *operator new(std::size_t size)
 {
-    App app{};
+    AllocationCounter::record();
 
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#endif
+
+int main(int argc, char **argv)
+{
     try {
+        App app{Options::parse(argc, argv)};
+
         app.run();
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
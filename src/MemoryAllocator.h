@@ -0,0 +1,504 @@
+#ifndef MELLIANCLIENT_MEMORYALLOCATOR_H
+#define MELLIANCLIENT_MEMORYALLOCATOR_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class MemoryBlock;
+
+struct Allocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+    MemoryBlock *block = nullptr;
+};
+
+// Free-list sub-allocator over a single VkDeviceMemory range. Holds no Vulkan calls so the
+// placement logic can be exercised without a device.
+class MemoryBlock
+{
+public:
+    struct UsedRange
+    {
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+        // bytes between the start of the free range it was placed in and the aligned offset
+        VkDeviceSize padding;
+    };
+
+    MemoryBlock(VkDeviceSize size, VkDeviceMemory memory = VK_NULL_HANDLE, void *mapped = nullptr)
+        : size{size}, memory{memory}, mapped{mapped}
+    {
+        free_ranges[0] = size;
+    }
+
+    MemoryBlock(const MemoryBlock &) = delete;
+
+    MemoryBlock &operator=(const MemoryBlock &) = delete;
+
+    // best fit over the free ranges. the alignment padding in front of the allocation belongs to it
+    // until it is freed, a sliver that small would only splinter the free list
+    bool allocate(VkDeviceSize request_size, VkDeviceSize alignment, VkDeviceSize &offset)
+    {
+        auto best = free_ranges.end();
+        VkDeviceSize best_offset = 0;
+        VkDeviceSize best_padding = 0;
+        VkDeviceSize best_remainder = 0;
+
+        for (auto it = free_ranges.begin(); it != free_ranges.end(); it++) {
+            VkDeviceSize aligned = alignUp(it->first, alignment);
+
+            if (aligned + request_size > it->first + it->second) {
+                continue;
+            }
+
+            VkDeviceSize padding = aligned - it->first;
+            VkDeviceSize remainder = it->second - padding - request_size;
+
+            // a tight fit first, then the least padding between equally tight ranges
+            if (best == free_ranges.end() || remainder < best_remainder ||
+                (remainder == best_remainder && padding < best_padding)) {
+                best = it;
+                best_offset = aligned;
+                best_padding = padding;
+                best_remainder = remainder;
+            }
+        }
+
+        if (best == free_ranges.end()) {
+            return false;
+        }
+
+        VkDeviceSize range_offset = best->first;
+        VkDeviceSize range_end = best->first + best->second;
+
+        free_ranges.erase(best);
+
+        if (best_offset + request_size < range_end) {
+            free_ranges[best_offset + request_size] = range_end - (best_offset + request_size);
+        }
+
+        used_ranges[best_offset] = {request_size, alignment, best_offset - range_offset};
+        used += request_size;
+        padding += best_offset - range_offset;
+        offset = best_offset;
+
+        return true;
+    }
+
+    void free(VkDeviceSize offset)
+    {
+        auto used_range = used_ranges.find(offset);
+
+        if (used_range == used_ranges.end()) {
+            throw std::runtime_error("failed to free memory: offset is not allocated in this block");
+        }
+
+        VkDeviceSize range_size = used_range->second.size;
+        VkDeviceSize range_padding = used_range->second.padding;
+
+        used_ranges.erase(used_range);
+        used -= range_size;
+        padding -= range_padding;
+
+        auto inserted = free_ranges.emplace(offset - range_padding, range_padding + range_size).first;
+
+        auto next = std::next(inserted);
+
+        if (next != free_ranges.end() && inserted->first + inserted->second == next->first) {
+            inserted->second += next->second;
+            free_ranges.erase(next);
+        }
+
+        if (inserted != free_ranges.begin()) {
+            auto previous = std::prev(inserted);
+
+            if (previous->first + previous->second == inserted->first) {
+                previous->second += inserted->second;
+                free_ranges.erase(inserted);
+            }
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return used_ranges.empty();
+    }
+
+    VkDeviceSize getSize() const
+    {
+        return size;
+    }
+
+    VkDeviceSize getUsed() const
+    {
+        return used;
+    }
+
+    // alignment padding held by live allocations, neither used nor available
+    VkDeviceSize getPadding() const
+    {
+        return padding;
+    }
+
+    VkDeviceSize getFree() const
+    {
+        return size - used - padding;
+    }
+
+    VkDeviceSize largestFreeRange() const
+    {
+        VkDeviceSize largest = 0;
+
+        for (const auto &[offset, range_size]: free_ranges) {
+            largest = std::max(largest, range_size);
+        }
+
+        return largest;
+    }
+
+    size_t freeRangeCount() const
+    {
+        return free_ranges.size();
+    }
+
+    size_t allocationCount() const
+    {
+        return used_ranges.size();
+    }
+
+    const std::map<VkDeviceSize, UsedRange> &getUsedRanges() const
+    {
+        return used_ranges;
+    }
+
+    VkDeviceMemory getMemory() const
+    {
+        return memory;
+    }
+
+    void *getMapped(VkDeviceSize offset) const
+    {
+        return mapped == nullptr ? nullptr : static_cast<char *>(mapped) + offset;
+    }
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+    }
+
+private:
+    VkDeviceSize size;
+    VkDeviceSize used = 0;
+    VkDeviceSize padding = 0;
+    VkDeviceMemory memory;
+    void *mapped;
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+    std::map<VkDeviceSize, UsedRange> used_ranges;
+};
+
+// Routes buffer and image memory through a few large vkAllocateMemory blocks per memory type
+// instead of one allocation per resource. Buffers and optimal-tiling images live in separate
+// pools so bufferImageGranularity never has to be considered inside a block. Buffers are created
+// and destroyed from both the main and the render thread, so every public call takes the lock.
+class MemoryAllocator
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    enum class ResourceKind
+    {
+        Linear = 0,
+        Optimal = 1,
+    };
+
+    struct HeapStats
+    {
+        VkDeviceSize used = 0;
+        VkDeviceSize padding = 0;
+        VkDeviceSize reserved = 0;
+        VkDeviceSize largest_free_range = 0;
+        uint32_t block_count = 0;
+        uint32_t allocation_count = 0;
+
+        // 0 when all free space is one contiguous range, approaching 1 as it splinters. alignment
+        // padding is not used but can never be allocated either, so it counts against the free space
+        float fragmentation() const
+        {
+            VkDeviceSize free = reserved - used;
+
+            return free == 0 ? 0.f : 1.f - static_cast<float>(largest_free_range) / static_cast<float>(free);
+        }
+    };
+
+    struct DefragmentationMove
+    {
+        Allocation source;
+        Allocation destination;
+    };
+
+    MemoryAllocator(VkPhysicalDevice physical_device, VkDevice device) : device{device}
+    {
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    }
+
+    ~MemoryAllocator()
+    {
+        for (auto &kinds: pools) {
+            for (auto &pool: kinds) {
+                for (auto &block: pool) {
+                    vkFreeMemory(device, block->getMemory(), nullptr);
+                }
+            }
+        }
+    }
+
+    MemoryAllocator(const MemoryAllocator &) = delete;
+
+    MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+    uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const
+    {
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+            if ((type_filter & (1 << i)) &&
+                (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    Allocation allocate(
+        const VkMemoryRequirements &requirements,
+        VkMemoryPropertyFlags properties,
+        ResourceKind kind
+    )
+    {
+        uint32_t memory_type = findMemoryType(requirements.memoryTypeBits, properties);
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        auto &pool = pools[memory_type][static_cast<size_t>(kind)];
+
+        Allocation allocation{};
+
+        for (auto &block: pool) {
+            if (tryAllocate(*block, requirements, allocation)) {
+                return allocation;
+            }
+        }
+
+        VkDeviceSize block_size = std::max(blockSizeFor(memory_type), requirements.size);
+
+        pool.push_back(createBlock(memory_type, block_size));
+
+        if (!tryAllocate(*pool.back(), requirements, allocation)) {
+            throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+        }
+
+        return allocation;
+    }
+
+    void free(Allocation &allocation)
+    {
+        if (allocation.block == nullptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        allocation.block->free(allocation.offset);
+        allocation = {};
+    }
+
+    using Pool = std::vector<std::unique_ptr<MemoryBlock>>;
+
+    // Defragmentation hook: proposes moving every allocation out of sparsely used blocks into
+    // free space of fuller blocks of the same pool. Destinations are already reserved, the owner
+    // copies the data, rebinds its resource and frees the source (or frees the destination to
+    // abandon a move). Empty blocks are then returned with releaseEmptyBlocks().
+    std::vector<DefragmentationMove> planDefragmentation(float max_block_usage = .25f)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        std::vector<DefragmentationMove> moves;
+
+        for (auto &kinds: pools) {
+            for (auto &pool: kinds) {
+                planDefragmentation(pool, max_block_usage, moves);
+            }
+        }
+
+        return moves;
+    }
+
+    // the planning for one pool, touches no Vulkan state. a block that received a destination is
+    // never evacuated afterwards and a block being evacuated never receives one, so no allocation is
+    // moved twice
+    static void planDefragmentation(Pool &pool, float max_block_usage, std::vector<DefragmentationMove> &moves)
+    {
+        std::vector<const MemoryBlock *> sources;
+        std::vector<const MemoryBlock *> destinations;
+
+        auto contains = [](const std::vector<const MemoryBlock *> &blocks, const MemoryBlock *block) {
+            return std::find(blocks.begin(), blocks.end(), block) != blocks.end();
+        };
+
+        for (auto &source_block: pool) {
+            float usage = static_cast<float>(source_block->getUsed()) / static_cast<float>(source_block->getSize());
+
+            if (source_block->isEmpty() || usage > max_block_usage || contains(destinations, source_block.get())) {
+                continue;
+            }
+
+            sources.push_back(source_block.get());
+
+            for (const auto &[offset, range]: source_block->getUsedRanges()) {
+                VkMemoryRequirements requirements{range.size, range.alignment, ~0u};
+                Allocation destination{};
+
+                for (auto &target_block: pool) {
+                    if (contains(sources, target_block.get()) ||
+                        target_block->getUsed() <= source_block->getUsed()) {
+                        continue;
+                    }
+
+                    if (tryAllocate(*target_block, requirements, destination)) {
+                        if (!contains(destinations, target_block.get())) {
+                            destinations.push_back(target_block.get());
+                        }
+
+                        break;
+                    }
+                }
+
+                if (destination.block == nullptr) {
+                    continue;
+                }
+
+                Allocation source{};
+
+                source.memory = source_block->getMemory();
+                source.offset = offset;
+                source.size = range.size;
+                source.mapped = source_block->getMapped(offset);
+                source.block = source_block.get();
+
+                moves.push_back({source, destination});
+            }
+        }
+    }
+
+    void releaseEmptyBlocks()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        for (auto &kinds: pools) {
+            for (auto &pool: kinds) {
+                auto removed = std::remove_if(pool.begin(), pool.end(), [this](const auto &block) {
+                    if (!block->isEmpty()) {
+                        return false;
+                    }
+
+                    vkFreeMemory(device, block->getMemory(), nullptr);
+
+                    return true;
+                });
+
+                pool.erase(removed, pool.end());
+            }
+        }
+    }
+
+    std::vector<HeapStats> getStats() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        std::vector<HeapStats> stats(memory_properties.memoryHeapCount);
+
+        for (uint32_t type = 0; type < memory_properties.memoryTypeCount; type++) {
+            auto &heap = stats[memory_properties.memoryTypes[type].heapIndex];
+
+            for (const auto &pool: pools[type]) {
+                for (const auto &block: pool) {
+                    heap.used += block->getUsed();
+                    heap.padding += block->getPadding();
+                    heap.reserved += block->getSize();
+                    heap.largest_free_range = std::max(heap.largest_free_range, block->largestFreeRange());
+                    heap.block_count++;
+                    heap.allocation_count += static_cast<uint32_t>(block->allocationCount());
+                }
+            }
+        }
+
+        return stats;
+    }
+
+private:
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    std::array<std::array<Pool, 2>, VK_MAX_MEMORY_TYPES> pools;
+    mutable std::mutex mutex;
+
+    static bool tryAllocate(MemoryBlock &block, const VkMemoryRequirements &requirements, Allocation &allocation)
+    {
+        VkDeviceSize offset;
+
+        if (!block.allocate(requirements.size, requirements.alignment, offset)) {
+            return false;
+        }
+
+        allocation.memory = block.getMemory();
+        allocation.offset = offset;
+        allocation.size = requirements.size;
+        allocation.mapped = block.getMapped(offset);
+        allocation.block = &block;
+
+        return true;
+    }
+
+    std::unique_ptr<MemoryBlock> createBlock(uint32_t memory_type, VkDeviceSize size)
+    {
+        VkMemoryAllocateInfo alloc_info{};
+
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = memory_type;
+
+        VkDeviceMemory memory;
+
+        if (vkAllocateMemory(device, &alloc_info, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory block!");
+        }
+
+        void *mapped = nullptr;
+
+        if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+                vkFreeMemory(device, memory, nullptr);
+
+                throw std::runtime_error("failed to map memory block!");
+            }
+        }
+
+        return std::make_unique<MemoryBlock>(size, memory, mapped);
+    }
+
+    // small heaps (integrated GPUs, the 256MB BAR window) get proportionally smaller blocks
+    VkDeviceSize blockSizeFor(uint32_t memory_type) const
+    {
+        VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+
+        return std::min(DEFAULT_BLOCK_SIZE, std::max<VkDeviceSize>(heap_size / 8, 1024 * 1024));
+    }
+};
+
+#endif //MELLIANCLIENT_MEMORYALLOCATOR_H
@@ -7,6 +7,7 @@
 #include <cassert>
 #include <glm/glm.hpp>
 #include "Device.h"
+#include "GeometryPool.h"
 
 class Model
 {
@@ -30,15 +31,37 @@ public:
         }
     };
 
-    Model(Device &device, const std::vector<Vertex> &vertices) : device{device}
+    // per-instance attributes streamed through vertex binding 1, the mat2 takes two locations
+    struct Instance
+    {
+        glm::mat2 transform{1.f};
+        glm::vec2 offset;
+        glm::vec3 color;
+
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions()
+        {
+            return {{1, sizeof(Instance), VK_VERTEX_INPUT_RATE_INSTANCE}};
+        }
+
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+        {
+            return {
+                {2, 1, VK_FORMAT_R32G32_SFLOAT,    offsetof(Instance, transform)},
+                {3, 1, VK_FORMAT_R32G32_SFLOAT,    offsetof(Instance, transform) + sizeof(glm::vec2)},
+                {4, 1, VK_FORMAT_R32G32_SFLOAT,    offsetof(Instance, offset)},
+                {5, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Instance, color)}
+            };
+        }
+    };
+
+    Model(GeometryPool &geometry, const std::vector<Vertex> &vertices) : geometry{geometry}
     {
         createVertexBuffers(vertices);
     }
 
     ~Model()
     {
-        vkDestroyBuffer(device.device(), vertex_buffer, nullptr);
-        vkFreeMemory(device.device(), vertex_buffer_memory, nullptr);
+        geometry.free(range);
     }
 
     Model(const Model &) = delete;
@@ -47,45 +70,46 @@ public:
 
     void bind(VkCommandBuffer command_buffer)
     {
-        VkBuffer buffers[] = {vertex_buffer};
+        VkBuffer buffers[] = {geometry.getBuffer(range.page)};
         VkDeviceSize offsets[] = {0};
 
         vkCmdBindVertexBuffers(command_buffer, 0, 1, buffers, offsets);
     }
 
-    void draw(VkCommandBuffer command_buffer)
+    void draw(VkCommandBuffer command_buffer, uint32_t instance_count = 1, uint32_t first_instance = 0)
     {
-        vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
+        vkCmdDraw(command_buffer, range.vertex_count, instance_count, range.first_vertex, first_instance);
     }
 
-private:
-    void createVertexBuffers(const std::vector<Vertex> &vertices)
+    // vertex data arrives asynchronously, models must not be drawn before this returns true
+    bool isUploaded() const
     {
-        vertex_count = static_cast<uint32_t>(vertices.size());
+        return geometry.isUploaded(range);
+    }
 
-        assert(vertex_count >= 3 && "vertex must be at least 3");
+    // models in the same geometry page share a vertex buffer and can be drawn by one indirect draw
+    uint32_t getPage() const
+    {
+        return range.page;
+    }
 
-        VkDeviceSize buffer_size = sizeof(vertices[0]) * vertex_count;
+    VkDrawIndirectCommand indirectCommand(uint32_t instance_count, uint32_t first_instance) const
+    {
+        return {range.vertex_count, instance_count, range.first_vertex, first_instance};
+    }
 
-        device.createBuffer(
-            buffer_size,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            vertex_buffer,
-            vertex_buffer_memory
-        );
+private:
+    void createVertexBuffers(const std::vector<Vertex> &vertices)
+    {
+        uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
 
-        void *data;
+        assert(vertex_count >= 3 && "vertex must be at least 3");
 
-        vkMapMemory(device.device(), vertex_buffer_memory, 0, buffer_size, 0, &data);
-        memcpy(data, vertices.data(), static_cast<size_t>(buffer_size));
-        vkUnmapMemory(device.device(), vertex_buffer_memory);
+        range = geometry.allocate(vertices.data(), vertex_count);
     }
 
-    Device &device;
-    VkBuffer vertex_buffer;
-    VkDeviceMemory vertex_buffer_memory;
-    uint32_t vertex_count;
+    GeometryPool &geometry;
+    GeometryPool::Range range;
 };
 
 #endif //MELLIANCLIENT_MODEL_H
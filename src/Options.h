@@ -0,0 +1,155 @@
+#ifndef MELLIANCLIENT_OPTIONS_H
+#define MELLIANCLIENT_OPTIONS_H
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include "SwapChain.h"
+
+struct Options
+{
+    static constexpr uint32_t BENCHMARK_OBJECTS = 10000;
+    static constexpr uint64_t BENCHMARK_FRAMES = 1000;
+
+    bool indirect = false;
+    bool parallel = false;
+    bool headless = false;
+    uint32_t stress_objects = 0;
+    uint32_t stress_models = 8;
+    // this many entities are destroyed and as many created every frame, while the render thread
+    // records the previous frame
+    uint32_t churn_per_frame = 0;
+    // 0 keeps running until the window is closed
+    uint64_t frame_limit = 0;
+    // frame statistics are written here as JSON when set
+    std::string benchmark_output;
+    // prints rolling GPU scope timings every report interval
+    bool gpu_profile = false;
+    // resolved GPU scopes are written here as a Chrome trace on exit when set
+    std::string gpu_trace_output;
+    // CPU zones are written here as a Chrome trace on exit, needs a MELLIANCLIENT_TRACE build
+    std::string trace_output;
+    SwapChain::Config swap_chain{};
+    // the render thread waits for a free frame slot before asking for a frame, so input is sampled
+    // just before recording instead of up to a frame earlier
+    bool low_latency = false;
+
+    static Options parse(int argc, char **argv)
+    {
+        Options options{};
+
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+
+            if (argument == "--indirect") {
+                options.indirect = true;
+            } else if (argument == "--parallel") {
+                options.parallel = true;
+            } else if (argument == "--headless") {
+                options.headless = true;
+            } else if (argument == "--frames") {
+                options.frame_limit = number<uint64_t>(argc, argv, i);
+            } else if (argument == "--stress") {
+                options.stress_objects = number<uint32_t>(argc, argv, i);
+            } else if (argument == "--models") {
+                options.stress_models = number<uint32_t>(argc, argv, i);
+            } else if (argument == "--churn") {
+                options.churn_per_frame = number<uint32_t>(argc, argv, i);
+            } else if (argument == "--benchmark") {
+                options.benchmark_output = value(argc, argv, i);
+            } else if (argument == "--gpu-profile") {
+                options.gpu_profile = true;
+            } else if (argument == "--gpu-trace") {
+                options.gpu_trace_output = value(argc, argv, i);
+            } else if (argument == "--trace") {
+                options.trace_output = value(argc, argv, i);
+            } else if (argument == "--frames-in-flight") {
+                options.swap_chain.frames_in_flight = number<uint32_t>(argc, argv, i);
+            } else if (argument == "--present-mode") {
+                options.swap_chain.present_mode = presentMode(value(argc, argv, i));
+            } else if (argument == "--swapchain-images") {
+                options.swap_chain.image_count = number<uint32_t>(argc, argv, i);
+            } else if (argument == "--low-latency") {
+                options.low_latency = true;
+            } else {
+                throw std::runtime_error("unknown option: " + argument);
+            }
+        }
+
+        if (options.swap_chain.frames_in_flight == 0
+            || options.swap_chain.frames_in_flight > SwapChain::MAX_FRAMES_IN_FLIGHT) {
+            throw std::runtime_error(
+                "--frames-in-flight must be between 1 and " + std::to_string(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            );
+        }
+
+        if (options.stress_models == 0) {
+            throw std::runtime_error("--models needs at least one model");
+        }
+
+        // a benchmark always runs the stress scene for a bounded number of frames
+        if (!options.benchmark_output.empty()) {
+            if (options.stress_objects == 0) {
+                options.stress_objects = BENCHMARK_OBJECTS;
+            }
+
+            if (options.frame_limit == 0) {
+                options.frame_limit = BENCHMARK_FRAMES;
+            }
+        }
+
+        return options;
+    }
+
+private:
+    static std::string value(int argc, char **argv, int &i)
+    {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("missing value for option: ") + argv[i]);
+        }
+
+        return argv[++i];
+    }
+
+    // std::stoull alone would accept "12abc" and report anything else as a bare "stoull", values
+    // that do not fit the option's type are rejected instead of truncated
+    template<typename T>
+    static T number(int argc, char **argv, int &i)
+    {
+        std::string option = argv[i];
+        std::string text = value(argc, argv, i);
+        size_t parsed = 0;
+        uint64_t result = 0;
+
+        try {
+            result = std::stoull(text, &parsed);
+        } catch (const std::exception &) {
+            parsed = 0;
+        }
+
+        if (parsed == 0 || parsed != text.size() || text[0] == '-' || result > std::numeric_limits<T>::max()) {
+            throw std::runtime_error("invalid value for option " + option + ": " + text);
+        }
+
+        return static_cast<T>(result);
+    }
+
+    static VkPresentModeKHR presentMode(const std::string &name)
+    {
+        for (auto mode: {
+            VK_PRESENT_MODE_IMMEDIATE_KHR,
+            VK_PRESENT_MODE_MAILBOX_KHR,
+            VK_PRESENT_MODE_FIFO_KHR,
+            VK_PRESENT_MODE_FIFO_RELAXED_KHR
+        }) {
+            if (name == SwapChain::presentModeName(mode)) {
+                return mode;
+            }
+        }
+
+        throw std::runtime_error("unknown present mode: " + name + ", expected mailbox, immediate, fifo or fifo-relaxed");
+    }
+};
+
+#endif //MELLIANCLIENT_OPTIONS_H
@@ -18,6 +18,8 @@ struct PipelineConfigInfo
 
     PipelineConfigInfo &operator=(const PipelineConfigInfo &) = delete;
 
+    std::vector<VkVertexInputBindingDescription> binding_descriptions{};
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions{};
     VkPipelineViewportStateCreateInfo viewport_info;
     VkPipelineInputAssemblyStateCreateInfo input_assembly_info;
     VkPipelineRasterizationStateCreateInfo rasterization_info;
@@ -40,16 +42,25 @@ public:
         const PipelineConfigInfo &config,
         const std::string &vert_path,
         const std::string &frag_path
+    ) : Pipeline{device, config, readFile(vert_path), readFile(frag_path)}
+    {
+    }
+
+    Pipeline(
+        Device &device,
+        const PipelineConfigInfo &config,
+        const std::vector<char> &vert_code,
+        const std::vector<char> &frag_code
     ) : device{device}
     {
-        createGraphicsPipeline(config, vert_path, frag_path);
+        createGraphicsPipeline(config, vert_code, frag_code);
     }
 
     ~Pipeline()
     {
         vkDestroyShaderModule(device.device(), vert_shader_module, nullptr);
         vkDestroyShaderModule(device.device(), frag_shader_module, nullptr);
-        vkDestroyPipeline(device.device(), graphics_pipeline, nullptr);
+        device.deferDestroyPipeline(graphics_pipeline);
     }
 
     Pipeline(const Pipeline &) = delete;
@@ -125,6 +136,9 @@ public:
         config_info.dynamic_state_info.pDynamicStates = config_info.dynamic_state_enables.data();
         config_info.dynamic_state_info.dynamicStateCount = static_cast<uint32_t>(config_info.dynamic_state_enables.size());
         config_info.dynamic_state_info.flags = 0;
+
+        config_info.binding_descriptions = Model::Vertex::getBindingDescriptions();
+        config_info.attribute_descriptions = Model::Vertex::getAttributeDescriptions();
     }
 
     void bind(VkCommandBuffer command_buffer)
@@ -132,12 +146,6 @@ public:
         vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
     }
 
-private:
-    Device &device;
-    VkPipeline graphics_pipeline;
-    VkShaderModule vert_shader_module;
-    VkShaderModule frag_shader_module;
-
     static std::vector<char> readFile(const std::string &path)
     {
         std::ifstream file{path, std::ios::ate | std::ios::binary};
@@ -157,10 +165,16 @@ private:
         return buffer;
     }
 
+private:
+    Device &device;
+    VkPipeline graphics_pipeline;
+    VkShaderModule vert_shader_module;
+    VkShaderModule frag_shader_module;
+
     void createGraphicsPipeline(
         const PipelineConfigInfo &config,
-        const std::string &vert_path,
-        const std::string &frag_path
+        const std::vector<char> &vert_code,
+        const std::vector<char> &frag_code
     )
     {
         assert(
@@ -174,9 +188,6 @@ private:
             "Cannot create graphics pipeline:: no render_pass provided in config"
         );
 
-        auto vert_code = readFile(vert_path);
-        auto frag_code = readFile(frag_path);
-
         createShaderModule(vert_code, &vert_shader_module);
         createShaderModule(frag_code, &frag_shader_module);
 
@@ -198,8 +209,8 @@ private:
         shader_stage[1].pNext = nullptr;
         shader_stage[1].pSpecializationInfo = nullptr;
 
-        auto binding_descriptions = Model::Vertex::getBindingDescriptions();
-        auto attribute_descriptions = Model::Vertex::getAttributeDescriptions();
+        auto &binding_descriptions = config.binding_descriptions;
+        auto &attribute_descriptions = config.attribute_descriptions;
 
         VkPipelineVertexInputStateCreateInfo vertex_input_info{};
 
@@ -232,7 +243,7 @@ private:
 
         if (vkCreateGraphicsPipelines(
             device.device(),
-            VK_NULL_HANDLE,
+            device.pipelineCache(),
             1,
             &pipeline_info,
             nullptr,
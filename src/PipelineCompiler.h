@@ -0,0 +1,174 @@
+#ifndef MELLIANCLIENT_PIPELINECOMPILER_H
+#define MELLIANCLIENT_PIPELINECOMPILER_H
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Device.h"
+#include "JobSystem.h"
+#include "Pipeline.h"
+#include "PipelineKey.h"
+
+// Handle to a pipeline that is being built on a worker thread. Until it is ready, resolve() hands
+// out the fallback it was compiled with (if any), callers skip their draws when both are missing.
+class AsyncPipeline
+{
+public:
+    bool isReady() const
+    {
+        return ready.load(std::memory_order_acquire);
+    }
+
+    void wait() const
+    {
+        ready.wait(false, std::memory_order_acquire);
+    }
+
+    // rethrows a compile failure from the worker on the calling thread
+    Pipeline *resolve()
+    {
+        if (isReady()) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            return pipeline.get();
+        }
+
+        return fallback == nullptr ? nullptr : fallback->resolve();
+    }
+
+private:
+    friend class PipelineCompiler;
+
+    std::unique_ptr<PipelineConfigInfo> config;
+    std::vector<char> vert_code;
+    std::vector<char> frag_code;
+    std::shared_ptr<AsyncPipeline> fallback;
+    std::unique_ptr<Pipeline> pipeline;
+    std::exception_ptr error;
+    std::atomic<bool> ready{false};
+};
+
+// Builds pipelines as jobs. Every worker goes through the device pipeline cache, which
+// Vulkan synchronizes internally, so variants compiled in parallel still feed one cache file.
+// Requests are deduplicated by PipelineKey: while a pipeline for identical state is alive, asking
+// for it again returns the same handle instead of compiling it a second time.
+class PipelineCompiler
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    PipelineCompiler(Device &device, JobSystem &jobs) : device{device}, jobs{jobs}
+    {
+    }
+
+    // compile jobs reference the compiler, none may outlive it
+    ~PipelineCompiler()
+    {
+        jobs.wait(in_flight);
+    }
+
+    PipelineCompiler(const PipelineCompiler &) = delete;
+
+    PipelineCompiler &operator=(PipelineCompiler &&) = delete;
+
+    // the config is heap allocated by the caller so the pointers inside it stay valid on the worker.
+    // the shaders are read here, the key and the compiled modules then always see the same bytes
+    std::shared_ptr<AsyncPipeline> compile(
+        std::unique_ptr<PipelineConfigInfo> config,
+        const std::string &vert_path,
+        const std::string &frag_path,
+        std::shared_ptr<AsyncPipeline> fallback = nullptr
+    )
+    {
+        std::vector<char> vert_code;
+        std::vector<char> frag_code;
+
+        try {
+            vert_code = Pipeline::readFile(vert_path);
+            frag_code = Pipeline::readFile(frag_path);
+        } catch (...) {
+            // reported through resolve() like a failed compile
+            auto handle = std::make_shared<AsyncPipeline>();
+
+            handle->fallback = std::move(fallback);
+            handle->error = std::current_exception();
+            handle->ready.store(true, std::memory_order_release);
+
+            return handle;
+        }
+
+        PipelineKey key{*config, vert_code, frag_code};
+
+        std::lock_guard<std::mutex> lock{registry_mutex};
+
+        auto existing = registry.find(key);
+
+        if (existing != registry.end()) {
+            if (auto handle = existing->second.lock()) {
+                hits++;
+
+                return handle;
+            }
+        }
+
+        misses++;
+
+        auto handle = std::make_shared<AsyncPipeline>();
+
+        registry.insert_or_assign(std::move(key), handle);
+
+        handle->config = std::move(config);
+        handle->vert_code = std::move(vert_code);
+        handle->frag_code = std::move(frag_code);
+        handle->fallback = std::move(fallback);
+
+        jobs.submit([this, handle]() {
+            try {
+                handle->pipeline = std::make_unique<Pipeline>(
+                    device,
+                    *handle->config,
+                    handle->vert_code,
+                    handle->frag_code
+                );
+            } catch (...) {
+                handle->error = std::current_exception();
+            }
+
+            handle->config.reset();
+            handle->vert_code = {};
+            handle->frag_code = {};
+            handle->ready.store(true, std::memory_order_release);
+            handle->ready.notify_all();
+        }, &in_flight);
+
+        return handle;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock{registry_mutex};
+
+        return {hits, misses};
+    }
+
+private:
+    Device &device;
+    JobSystem &jobs;
+    JobCounter in_flight;
+    std::mutex registry_mutex;
+    std::unordered_map<PipelineKey, std::weak_ptr<AsyncPipeline>, PipelineKey::Hasher> registry;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+#endif //MELLIANCLIENT_PIPELINECOMPILER_H
@@ -0,0 +1,190 @@
+#ifndef MELLIANCLIENT_PIPELINEKEY_H
+#define MELLIANCLIENT_PIPELINEKEY_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include "Pipeline.h"
+
+// Canonical flattening of everything in a PipelineConfigInfo that ends up baked into a VkPipeline.
+// Pointers inside the create infos are followed, never hashed, so two configs built separately
+// with the same state produce equal keys. Render passes are compared by handle, which is stricter
+// than Vulkan render pass compatibility but never wrong. Shaders are keyed by their SPIR-V bytes
+// rather than their paths, so a shader recompiled in place gets a new pipeline.
+class PipelineKey
+{
+public:
+    PipelineKey(const PipelineConfigInfo &config, const std::vector<char> &vert_code, const std::vector<char> &frag_code)
+    {
+        addCode(vert_code);
+        addCode(frag_code);
+
+        add(config.binding_descriptions.size());
+        for (const auto &binding: config.binding_descriptions) {
+            add(binding.binding);
+            add(binding.stride);
+            add(binding.inputRate);
+        }
+
+        add(config.attribute_descriptions.size());
+        for (const auto &attribute: config.attribute_descriptions) {
+            add(attribute.location);
+            add(attribute.binding);
+            add(attribute.format);
+            add(attribute.offset);
+        }
+
+        add(config.input_assembly_info.topology);
+        add(config.input_assembly_info.primitiveRestartEnable);
+
+        add(config.viewport_info.viewportCount);
+        add(config.viewport_info.scissorCount);
+
+        const auto &raster = config.rasterization_info;
+        add(raster.depthClampEnable);
+        add(raster.rasterizerDiscardEnable);
+        add(raster.polygonMode);
+        add(raster.cullMode);
+        add(raster.frontFace);
+        add(raster.depthBiasEnable);
+        add(raster.depthBiasConstantFactor);
+        add(raster.depthBiasClamp);
+        add(raster.depthBiasSlopeFactor);
+        add(raster.lineWidth);
+
+        const auto &multisample = config.multisample_info;
+        add(multisample.rasterizationSamples);
+        add(multisample.sampleShadingEnable);
+        add(multisample.minSampleShading);
+        add(multisample.alphaToCoverageEnable);
+        add(multisample.alphaToOneEnable);
+
+        const auto &blend = config.color_blend_info;
+        add(blend.logicOpEnable);
+        add(blend.logicOp);
+        for (float constant: blend.blendConstants) {
+            add(constant);
+        }
+        add(blend.attachmentCount);
+        for (uint32_t i = 0; i < blend.attachmentCount; i++) {
+            const auto &attachment = blend.pAttachments[i];
+            add(attachment.blendEnable);
+            add(attachment.srcColorBlendFactor);
+            add(attachment.dstColorBlendFactor);
+            add(attachment.colorBlendOp);
+            add(attachment.srcAlphaBlendFactor);
+            add(attachment.dstAlphaBlendFactor);
+            add(attachment.alphaBlendOp);
+            add(attachment.colorWriteMask);
+        }
+
+        const auto &depth = config.depth_stencil_info;
+        add(depth.depthTestEnable);
+        add(depth.depthWriteEnable);
+        add(depth.depthCompareOp);
+        add(depth.depthBoundsTestEnable);
+        add(depth.stencilTestEnable);
+        addStencil(depth.front);
+        addStencil(depth.back);
+        add(depth.minDepthBounds);
+        add(depth.maxDepthBounds);
+
+        add(config.dynamic_state_info.dynamicStateCount);
+        for (uint32_t i = 0; i < config.dynamic_state_info.dynamicStateCount; i++) {
+            add(config.dynamic_state_info.pDynamicStates[i]);
+        }
+
+        addHandle(config.pipeline_layout);
+        addHandle(config.render_pass);
+        add(config.subpass);
+
+        hash_value = computeHash();
+    }
+
+    bool operator==(const PipelineKey &other) const
+    {
+        return hash_value == other.hash_value && words == other.words;
+    }
+
+    size_t hash() const
+    {
+        return hash_value;
+    }
+
+    struct Hasher
+    {
+        size_t operator()(const PipelineKey &key) const
+        {
+            return key.hash();
+        }
+    };
+
+private:
+    std::vector<uint32_t> words;
+    size_t hash_value;
+
+    template<typename T>
+    void add(T value) requires std::is_integral_v<T> || std::is_enum_v<T>
+    {
+        words.push_back(static_cast<uint32_t>(value));
+    }
+
+    void add(float value)
+    {
+        uint32_t bits;
+
+        memcpy(&bits, &value, sizeof(bits));
+        words.push_back(bits);
+    }
+
+    template<typename T>
+    void addHandle(T handle)
+    {
+        uint64_t value = reinterpret_cast<uint64_t>(handle);
+
+        words.push_back(static_cast<uint32_t>(value));
+        words.push_back(static_cast<uint32_t>(value >> 32));
+    }
+
+    void addStencil(const VkStencilOpState &stencil)
+    {
+        add(stencil.failOp);
+        add(stencil.passOp);
+        add(stencil.depthFailOp);
+        add(stencil.compareOp);
+        add(stencil.compareMask);
+        add(stencil.writeMask);
+        add(stencil.reference);
+    }
+
+    // the size and a 64 bit digest stand in for the module, a few kilobytes each are not worth keeping
+    void addCode(const std::vector<char> &code)
+    {
+        uint64_t digest = fnv1a(code.data(), code.size());
+
+        add(code.size());
+        words.push_back(static_cast<uint32_t>(digest));
+        words.push_back(static_cast<uint32_t>(digest >> 32));
+    }
+
+    size_t computeHash() const
+    {
+        return static_cast<size_t>(fnv1a(words.data(), words.size() * sizeof(uint32_t)));
+    }
+
+    static uint64_t fnv1a(const void *data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto bytes = static_cast<const unsigned char *>(data);
+
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+};
+
+#endif //MELLIANCLIENT_PIPELINEKEY_H
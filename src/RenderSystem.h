@@ -4,32 +4,74 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <exception>
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 #include "Device.h"
-#include "GameObject.h"
+#include "EntityStore.h"
+#include "FrameArena.h"
+#include "FrameRing.h"
+#include "JobSystem.h"
 #include "Pipeline.h"
-
-struct SimplePushConstantData
-{
-    glm::mat2 transform{1.f};
-    glm::vec2 offset;
-    alignas(16) glm::vec3 color;
-};
+#include "PipelineCompiler.h"
+#include "Renderer.h"
+#include "Simulation.h"
+#include "SwapChain.h"
+#include "Trace.h"
+#include "TransformKernel.h"
 
 class RenderSystem
 {
 public:
-    RenderSystem(Device &device, VkRenderPass render_pass) : device{device}
+    // per-frame values every draw reads from set 0 binding 0, laid out for std140. the view maps
+    // world positions to clip space as position * view_scale + view_offset
+    struct FrameGlobals
+    {
+        glm::vec2 view_scale{1.f, 1.f};
+        glm::vec2 view_offset{0.f, 0.f};
+        float time = 0.f;
+    };
+
+    // with a job system the direct path is split over secondary command buffers, one per worker
+    // plus one for the calling thread, the indirect path is a handful of commands and stays inline
+    RenderSystem(
+        Device &device,
+        Renderer &renderer,
+        PipelineCompiler &pipeline_compiler,
+        JobSystem *recording_jobs = nullptr,
+        bool indirect = false
+    ) : device{device}, renderer{renderer}, pipeline_compiler{pipeline_compiler}
     {
+        // non-zero firstInstance in indirect commands needs drawIndirectFirstInstance
+        use_indirect = indirect && device.features.drawIndirectFirstInstance;
+
+        if (recording_jobs != nullptr && !use_indirect) {
+            jobs = recording_jobs;
+            renderer.createSecondaryCommandPools(jobs->workerCount() + 1);
+        }
+
+        createDescriptorSets();
         createPipelineLayout();
-        createPipeline(render_pass);
+        createPipeline(renderer.getSwapChainRenderPass());
     }
 
     ~RenderSystem()
     {
+        for (auto &frame: frames) {
+            device.deferFree(frame.globals);
+        }
+
+        // a worker may still be building against this layout
+        pipeline->wait();
+        pipeline.reset();
+
         vkDestroyPipelineLayout(device.device(), pipeline_layout, nullptr);
     }
 
@@ -37,53 +79,405 @@ public:
 
     RenderSystem &operator=(RenderSystem &&) = delete;
 
-    void renderGameObjects(VkCommandBuffer command_buffer, std::vector<GameObject> &game_objects)
+    void setView(glm::vec2 scale, glm::vec2 offset)
+    {
+        globals.view_scale = scale;
+        globals.view_offset = offset;
+    }
+
+    bool usesIndirect() const
+    {
+        return use_indirect;
+    }
+
+    // the render pass has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when set
+    bool recordsSecondaries() const
     {
-        pipeline->bind(command_buffer);
+        return jobs != nullptr;
+    }
 
-        for (auto &object: game_objects) {
-            object.transform_2d.rotation = glm::mod(object.transform_2d.rotation + .01f, glm::two_pi<float>());
+    // entities sharing a model become one instanced draw, their transforms and colors are written
+    // into the renderer's frame ring next to the frame globals, which are pushed once and bound
+    // through a dynamic offset. everything is read from the simulation snapshot, never from the store,
+    // so the main thread may change the store while this frame is recorded
+    void renderEntities(VkCommandBuffer command_buffer, const Simulation::Snapshot &snapshot)
+    {
+        TRACE_ZONE("RenderSystem::renderEntities");
 
-            SimplePushConstantData push{};
+        Pipeline *active_pipeline = pipeline->resolve();
 
-            push.offset = object.transform_2d.translation;
-            push.color = object.color;
-            push.transform = object.transform_2d.mat2();
+        if (snapshot.size() == 0 || active_pipeline == nullptr) {
+            return;
+        }
 
-            vkCmdPushConstants(
-                command_buffer,
-                pipeline_layout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push
-            );
+        buildDrawOrder(snapshot);
 
-            object.model->bind(command_buffer);
-            object.model->draw(command_buffer);
+        if (draw_order.empty()) {
+            return;
+        }
+
+        auto frame = beginFrameData();
+
+        if (jobs != nullptr) {
+            recordParallel(command_buffer, *active_pipeline, frame, snapshot);
+
+            return;
+        }
+
+        writeInstances(frame, snapshot, 0, static_cast<uint32_t>(draw_order.size()));
+        bindFrame(command_buffer, *active_pipeline, frame);
+
+        if (use_indirect) {
+            recordIndirect(command_buffer, frame);
+        } else {
+            recordDraws(command_buffer, 0, static_cast<uint32_t>(draw_order.size()));
         }
     }
 
 private:
+    // one descriptor set per frame slot, rewritten whenever the slot's ring buffer was replaced
+    struct FrameResources
+    {
+        DescriptorAllocator::Set globals;
+        VkBuffer ring_buffer = VK_NULL_HANDLE;
+    };
+
+    // where this frame's data landed in the frame ring
+    struct FrameData
+    {
+        VkBuffer buffer;
+        VkDescriptorSet descriptor_set;
+        uint32_t globals_offset;
+        Model::Instance *instances;
+        VkDeviceSize instances_offset;
+    };
+
+    struct DrawBatch
+    {
+        Model *model;
+        uint32_t first_instance;
+        uint32_t instance_count;
+    };
+
     Device &device;
-    std::unique_ptr<Pipeline> pipeline;
+    Renderer &renderer;
+    PipelineCompiler &pipeline_compiler;
+    JobSystem *jobs = nullptr;
+    bool use_indirect;
+    std::shared_ptr<AsyncPipeline> pipeline;
+    VkDescriptorSetLayout globals_layout;
     VkPipelineLayout pipeline_layout;
+    std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+    FrameGlobals globals;
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    // draw lists are rebuilt in the renderer's frame arena every frame
+    ArenaVector<EntityStore::ModelHandle> model_order;
+    ArenaVector<uint32_t> model_offsets;
+    ArenaVector<uint32_t> draw_order;
+    ArenaVector<DrawBatch> draw_batches;
+    ArenaVector<VkCommandBuffer> secondaries;
+    std::vector<std::exception_ptr> secondary_errors;
 
-    void createPipelineLayout()
+    // counting sort of the dense slots by model, models are ordered by geometry page so each page
+    // is bound once, entities whose model is still uploading are left out
+    void buildDrawOrder(const Simulation::Snapshot &snapshot)
+    {
+        auto &models = snapshot.models;
+        auto &model_table = snapshot.model_table;
+        auto &arena = renderer.getFrameArena();
+        auto model_count = static_cast<EntityStore::ModelHandle>(model_table.size());
+
+        model_offsets = ArenaVector<uint32_t>(model_count, 0, arena);
+        model_order = ArenaVector<EntityStore::ModelHandle>(arena);
+        draw_batches = ArenaVector<DrawBatch>(arena);
+        draw_order = ArenaVector<uint32_t>(arena);
+
+        model_order.reserve(model_count);
+        draw_batches.reserve(model_count);
+
+        for (auto model: models) {
+            model_offsets[model]++;
+        }
+
+        for (EntityStore::ModelHandle model = 0; model < model_count; model++) {
+            if (model_offsets[model] > 0 && model_table[model]->isUploaded()) {
+                model_order.push_back(model);
+            }
+        }
+
+        std::sort(model_order.begin(), model_order.end(), [&model_table](auto a, auto b) {
+            return model_table[a]->getPage() < model_table[b]->getPage();
+        });
+
+        uint32_t instance_count = 0;
+
+        for (auto model: model_order) {
+            draw_batches.push_back({model_table[model].get(), instance_count, model_offsets[model]});
+            instance_count += model_offsets[model];
+        }
+
+        std::fill(model_offsets.begin(), model_offsets.end(), EntityStore::INVALID_INDEX);
+
+        for (size_t i = 0; i < model_order.size(); i++) {
+            model_offsets[model_order[i]] = draw_batches[i].first_instance;
+        }
+
+        draw_order.resize(instance_count);
+
+        for (uint32_t i = 0; i < models.size(); i++) {
+            auto &offset = model_offsets[models[i]];
+
+            if (offset != EntityStore::INVALID_INDEX) {
+                draw_order[offset++] = i;
+            }
+        }
+    }
+
+    // everything written to the ring this frame is reserved up front so the globals, the instances
+    // and the indirect commands share one ring buffer, the one set 0 and binding 1 point at
+    FrameData beginFrameData()
     {
-        VkPushConstantRange push_constant_range;
+        auto &ring = renderer.getFrameRing();
+        auto &resources = frames[renderer.getFrameIndex()];
+
+        VkDeviceSize size = sizeof(FrameGlobals) + draw_order.size() * sizeof(Model::Instance);
 
-        push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        push_constant_range.offset = 0;
-        push_constant_range.size = sizeof(SimplePushConstantData);
+        if (use_indirect) {
+            size += draw_batches.size() * sizeof(VkDrawIndirectCommand);
+        }
+
+        ring.reserve(size + 3 * ring.maxAlignment());
+
+        if (resources.ring_buffer != ring.buffer()) {
+            resources.ring_buffer = ring.buffer();
+            writeDescriptorSet(resources);
+        }
 
+        globals.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+
+        auto globals_offset = ring.pushUniform(globals);
+        auto instances = ring.allocate(draw_order.size() * sizeof(Model::Instance), alignof(Model::Instance));
+
+        assert(instances.buffer == resources.ring_buffer && "frame data was not reserved");
+
+        return {
+            resources.ring_buffer,
+            resources.globals.set,
+            static_cast<uint32_t>(globals_offset),
+            static_cast<Model::Instance *>(instances.data),
+            instances.offset
+        };
+    }
+
+    void bindFrame(VkCommandBuffer command_buffer, Pipeline &active_pipeline, const FrameData &frame)
+    {
+        active_pipeline.bind(command_buffer);
+
+        vkCmdBindDescriptorSets(
+            command_buffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            pipeline_layout,
+            0,
+            1,
+            &frame.descriptor_set,
+            1,
+            &frame.globals_offset
+        );
+
+        vkCmdBindVertexBuffers(command_buffer, 1, 1, &frame.buffer, &frame.instances_offset);
+    }
+
+    void writeInstances(
+        const FrameData &frame,
+        const Simulation::Snapshot &snapshot,
+        uint32_t begin,
+        uint32_t end
+    )
+    {
+        TransformKernel::Input input{
+            draw_order.data(),
+            snapshot.translations.data(),
+            snapshot.scales.data(),
+            snapshot.rotations.data(),
+            snapshot.colors.data()
+        };
+
+        TransformKernel::writeInstances(input, frame.instances, begin, end);
+    }
+
+    // draws the instances in [begin, end), a batch straddling either edge is clipped to it
+    void recordDraws(VkCommandBuffer command_buffer, uint32_t begin, uint32_t end)
+    {
+        auto batch = std::upper_bound(
+            draw_batches.begin(),
+            draw_batches.end(),
+            begin,
+            [](uint32_t instance, const DrawBatch &batch) { return instance < batch.first_instance; }
+        ) - 1;
+
+        Model *bound_model = nullptr;
+
+        for (; batch != draw_batches.end() && batch->first_instance < end; ++batch) {
+            uint32_t first = std::max(begin, batch->first_instance);
+            uint32_t last = std::min(end, batch->first_instance + batch->instance_count);
+
+            if (batch->model != bound_model) {
+                batch->model->bind(command_buffer);
+                bound_model = batch->model;
+            }
+
+            batch->model->draw(command_buffer, last - first, first);
+        }
+    }
+
+    // instances are split evenly over the slots, each slot writes its part of the instance buffer and
+    // records it into its own secondary, the calling thread takes slot 0 and helps with the rest
+    void recordParallel(
+        VkCommandBuffer command_buffer,
+        Pipeline &active_pipeline,
+        const FrameData &frame,
+        const Simulation::Snapshot &snapshot
+    )
+    {
+        uint32_t instance_count = static_cast<uint32_t>(draw_order.size());
+        uint32_t slot_count = std::min(renderer.secondarySlotCount(), instance_count);
+        uint32_t chunk_size = (instance_count + slot_count - 1) / slot_count;
+
+        slot_count = (instance_count + chunk_size - 1) / chunk_size;
+
+        secondaries = ArenaVector<VkCommandBuffer>(slot_count, VK_NULL_HANDLE, renderer.getFrameArena());
+        secondary_errors.assign(slot_count, nullptr);
+
+        auto record_slot = [this, &active_pipeline, &frame, &snapshot, instance_count, chunk_size](uint32_t slot) {
+            uint32_t begin = slot * chunk_size;
+            uint32_t end = std::min(instance_count, begin + chunk_size);
+
+            try {
+                writeInstances(frame, snapshot, begin, end);
+
+                auto secondary = renderer.beginSecondaryCommandBuffer(slot);
+
+                bindFrame(secondary, active_pipeline, frame);
+                recordDraws(secondary, begin, end);
+
+                if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to record secondary command buffer");
+                }
+
+                secondaries[slot] = secondary;
+            } catch (...) {
+                secondary_errors[slot] = std::current_exception();
+            }
+        };
+
+        JobCounter recorded;
+
+        for (uint32_t slot = 1; slot < slot_count; slot++) {
+            jobs->submit([&record_slot, slot]() { record_slot(slot); }, &recorded);
+        }
+
+        record_slot(0);
+        jobs->wait(recorded);
+
+        for (auto &error: secondary_errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        vkCmdExecuteCommands(command_buffer, slot_count, secondaries.data());
+    }
+
+    // one vkCmdDrawIndirect per geometry page, the per-model parameters live in the frame ring
+    void recordIndirect(VkCommandBuffer command_buffer, const FrameData &frame)
+    {
+        auto slice = renderer.getFrameRing().allocate(
+            draw_batches.size() * sizeof(VkDrawIndirectCommand),
+            alignof(VkDrawIndirectCommand)
+        );
+
+        auto commands = static_cast<VkDrawIndirectCommand *>(slice.data);
+
+        for (size_t i = 0; i < draw_batches.size(); i++) {
+            commands[i] = draw_batches[i].model->indirectCommand(
+                draw_batches[i].instance_count,
+                draw_batches[i].first_instance
+            );
+        }
+
+        uint32_t max_draw_count = device.features.multiDrawIndirect ? device.properties.limits.maxDrawIndirectCount : 1;
+        uint32_t first_command = 0;
+
+        for (uint32_t i = 1; i <= draw_batches.size(); i++) {
+            if (i < draw_batches.size() &&
+                draw_batches[i].model->getPage() == draw_batches[first_command].model->getPage()) {
+                continue;
+            }
+
+            draw_batches[first_command].model->bind(command_buffer);
+
+            for (uint32_t command = first_command; command < i; command += max_draw_count) {
+                vkCmdDrawIndirect(
+                    command_buffer,
+                    slice.buffer,
+                    slice.offset + command * sizeof(VkDrawIndirectCommand),
+                    std::min(max_draw_count, i - command),
+                    sizeof(VkDrawIndirectCommand)
+                );
+            }
+
+            first_command = i;
+        }
+    }
+
+    void createDescriptorSets()
+    {
+        VkDescriptorSetLayoutBinding globals_binding{};
+
+        globals_binding.binding = 0;
+        globals_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        globals_binding.descriptorCount = 1;
+        globals_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        globals_layout = device.getDescriptorAllocator().getLayout({globals_binding});
+
+        for (uint32_t i = 0; i < renderer.framesInFlight(); i++) {
+            frames[i].globals = device.getDescriptorAllocator().allocate(globals_layout);
+        }
+    }
+
+    // the previous use of this frame slot has retired, so its set can be rewritten in place
+    void writeDescriptorSet(FrameResources &resources)
+    {
+        VkDescriptorBufferInfo buffer_info{};
+
+        buffer_info.buffer = resources.ring_buffer;
+        buffer_info.offset = 0;
+        buffer_info.range = sizeof(FrameGlobals);
+
+        VkWriteDescriptorSet write{};
+
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = resources.globals.set;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &buffer_info;
+
+        vkUpdateDescriptorSets(device.device(), 1, &write, 0, nullptr);
+    }
+
+    // the shaders only read the frame globals, the device's bindless table joins the layout once a
+    // shader includes bindless.glsl
+    void createPipelineLayout()
+    {
         VkPipelineLayoutCreateInfo pipeline_layout_info{};
 
         pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_info.setLayoutCount = 0;
-        pipeline_layout_info.pSetLayouts = nullptr;
-        pipeline_layout_info.pushConstantRangeCount = 1;
-        pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+        pipeline_layout_info.setLayoutCount = 1;
+        pipeline_layout_info.pSetLayouts = &globals_layout;
+        pipeline_layout_info.pushConstantRangeCount = 0;
+        pipeline_layout_info.pPushConstantRanges = nullptr;
 
         if (vkCreatePipelineLayout(device.device(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout");
@@ -94,16 +488,30 @@ private:
     {
         assert(pipeline_layout != nullptr && "cannot create pipeline before pipeline layout");
 
-        PipelineConfigInfo pipeline_config{};
+        auto config = std::make_unique<PipelineConfigInfo>();
+        auto &pipeline_config = *config;
 
         Pipeline::defaultPipelineConfigInfo(pipeline_config);
 
+        auto instance_bindings = Model::Instance::getBindingDescriptions();
+        auto instance_attributes = Model::Instance::getAttributeDescriptions();
+
+        pipeline_config.binding_descriptions.insert(
+            pipeline_config.binding_descriptions.end(),
+            instance_bindings.begin(),
+            instance_bindings.end()
+        );
+        pipeline_config.attribute_descriptions.insert(
+            pipeline_config.attribute_descriptions.end(),
+            instance_attributes.begin(),
+            instance_attributes.end()
+        );
+
         pipeline_config.render_pass = render_pass;
         pipeline_config.pipeline_layout = pipeline_layout;
 
-        pipeline = std::make_unique<Pipeline>(
-            device,
-            pipeline_config,
+        pipeline = pipeline_compiler.compile(
+            std::move(config),
             "../../src/Shaders/shader.vert.spv",
             "../../src/Shaders/shader.frag.spv"
         );
@@ -1,24 +1,57 @@
 #ifndef MELLIANCLIENT_RENDERER_H
 #define MELLIANCLIENT_RENDERER_H
 
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 #include "Device.h"
+#include "FrameArena.h"
+#include "FrameRing.h"
+#include "GpuProfiler.h"
 #include "SwapChain.h"
+#include "Trace.h"
 #include "Window.h"
 
 class Renderer
 {
 public:
-    Renderer(Window &window, Device &device) : window{window}, device{device}
+    // resize events closer together than this are treated as one drag, the suboptimal swap chain
+    // keeps presenting until the size settled. an out of date swap chain is recreated right away
+    static constexpr std::chrono::milliseconds RESIZE_DEBOUNCE{50};
+
+    // CPU time spent in each stage of the last finished frame. gpu_ms is the profiler's "frame" scope
+    // around the whole primary command buffer and belongs to the frame that last used the same
+    // frame index, it stays negative when the queue cannot write timestamps.
+    struct FrameTimings
     {
-        recreateSwapChain();
+        double acquire_ms = 0.;
+        double submit_ms = 0.;
+        double present_ms = 0.;
+        double gpu_ms = -1.;
+    };
+
+    Renderer(Window &window, Device &device, const SwapChain::Config &swap_chain_config = {})
+        : window{window}, device{device}, swap_chain_config{swap_chain_config},
+          profiler{device, swap_chain_config.frames_in_flight},
+          frame_ring{device, swap_chain_config.frames_in_flight}
+    {
+        if (!recreateSwapChain()) {
+            throw std::runtime_error("failed to create swap chain for a minimized window");
+        }
+
         createCommandBuffers();
+
+        for (uint32_t i = 0; i < swap_chain_config.frames_in_flight; i++) {
+            frame_arenas.push_back(std::make_unique<FrameArena>());
+        }
     }
 
     ~Renderer()
     {
+        destroySecondaryCommandPools();
         freeCommandBuffers();
     }
 
@@ -47,8 +80,14 @@ public:
     {
         assert(!is_frame_started && "cannot call beginFrame while already in progress");
 
+        TRACE_ZONE("Renderer::beginFrame");
+
+        auto acquire_start = std::chrono::steady_clock::now();
         auto result = swap_chain->acquireNextImage(&current_image_index);
 
+        timings = {};
+        timings.acquire_ms = millisecondsSince(acquire_start);
+
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
 
@@ -61,6 +100,22 @@ public:
 
         is_frame_started = true;
 
+        frame_arenas[current_frame_index]->reset();
+        frame_ring.beginFrame(current_frame_index);
+
+        // every frame up to the one that last used this frame slot has finished now
+        auto submitted = device.deletionQueue().submittedFrames();
+
+        if (submitted >= swap_chain_config.frames_in_flight) {
+            device.deletionQueue().collect(submitted - swap_chain_config.frames_in_flight + 1);
+        }
+
+        // the fence waited on in acquireNextImage guarantees this frame's secondaries are retired
+        for (auto &slot: secondary_pools[current_frame_index]) {
+            vkResetCommandPool(device.device(), slot.pool, 0);
+            slot.used = 0;
+        }
+
         auto command_buffer = getCurrentCommandBuffer();
 
         VkCommandBufferBeginInfo begin_info{};
@@ -71,6 +126,11 @@ public:
             throw std::runtime_error("failed to begin recording command buffer");
         }
 
+        profiler.beginFrame(command_buffer, current_frame_index);
+
+        timings.gpu_ms = profiler.lastMs("frame");
+        frame_scope = profiler.beginScope(command_buffer, "frame");
+
         return command_buffer;
     }
 
@@ -78,26 +138,47 @@ public:
     {
         assert(is_frame_started && "cannot call endFrame while frame is not in progress");
 
+        TRACE_ZONE("Renderer::endFrame");
+
         auto command_buffer = getCurrentCommandBuffer();
 
+        profiler.endScope(command_buffer, frame_scope);
+
         if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer");
         }
 
-        auto result = swap_chain->submitCommandBuffers(&command_buffer, &current_image_index);
+        auto submit_start = std::chrono::steady_clock::now();
+
+        swap_chain->submitCommandBuffers(&command_buffer, &current_image_index);
+        device.deletionQueue().markSubmitted();
+
+        auto present_start = std::chrono::steady_clock::now();
+        auto result = swap_chain->present(&current_image_index);
+
+        timings.submit_ms = std::chrono::duration<double, std::milli>(present_start - submit_start).count();
+        timings.present_ms = millisecondsSince(present_start);
+
+        bool resized = result == VK_SUBOPTIMAL_KHR || window.wasWindowResized();
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.wasWindowResized()) {
-            window.resetWindowResizeFlag();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
-        } else if (result != VK_SUCCESS) {
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
             throw std::runtime_error("failed to present swap chain image");
+        } else if (resized && window.timeSinceResize() >= RESIZE_DEBOUNCE) {
+            recreateSwapChain();
         }
 
         is_frame_started = false;
-        current_frame_index = (current_frame_index + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+        current_frame_index = (current_frame_index + 1) % static_cast<int>(swap_chain_config.frames_in_flight);
     }
 
-    void beginSwapChainRenderPass(VkCommandBuffer command_buffer)
+    // with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only be filled through
+    // vkCmdExecuteCommands, the secondaries then set their own viewport and scissor
+    void beginSwapChainRenderPass(
+        VkCommandBuffer command_buffer,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+    )
     {
         assert(is_frame_started && "cannot call beginSwapChainRenderPass if frame is not in progress");
         assert(
@@ -123,8 +204,96 @@ public:
         render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
         render_pass_info.pClearValues = clear_values.data();
 
-        vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+        // timestamps cannot be written inside a pass whose contents are secondary command buffers
+        pass_scope = profiler.beginScope(command_buffer, "main pass");
+
+        vkCmdBeginRenderPass(command_buffer, &render_pass_info, contents);
+
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            setViewportAndScissor(command_buffer);
+        }
+    }
+
+    // one pool per recording slot and frame in flight, a slot must only be used by one thread at a time
+    void createSecondaryCommandPools(uint32_t slot_count)
+    {
+        destroySecondaryCommandPools();
+
+        QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
+
+        VkCommandPoolCreateInfo pool_info{};
+
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.queueFamilyIndex = indices.graphicsFamily;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (uint32_t i = 0; i < swap_chain_config.frames_in_flight; i++) {
+            auto &frame = secondary_pools[i];
+
+            frame.resize(slot_count);
+
+            for (auto &slot: frame) {
+                if (vkCreateCommandPool(device.device(), &pool_info, nullptr, &slot.pool) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create secondary command pool");
+                }
+            }
+        }
+    }
+
+    uint32_t secondarySlotCount() const
+    {
+        return static_cast<uint32_t>(secondary_pools[0].size());
+    }
+
+    VkCommandBuffer beginSecondaryCommandBuffer(uint32_t slot_index)
+    {
+        assert(is_frame_started && "cannot begin secondary command buffer if frame is not in progress");
+
+        auto &slot = secondary_pools[current_frame_index][slot_index];
+
+        if (slot.used == slot.command_buffers.size()) {
+            VkCommandBufferAllocateInfo alloc_info{};
+
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandPool = slot.pool;
+            alloc_info.commandBufferCount = 1;
+
+            VkCommandBuffer command_buffer;
+
+            if (vkAllocateCommandBuffers(device.device(), &alloc_info, &command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffer");
+            }
+
+            slot.command_buffers.push_back(command_buffer);
+        }
+
+        auto command_buffer = slot.command_buffers[slot.used++];
+
+        VkCommandBufferInheritanceInfo inheritance_info{};
+
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = swap_chain->getRenderPass();
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = swap_chain->getFrameBuffer(current_image_index);
 
+        VkCommandBufferBeginInfo begin_info{};
+
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        begin_info.pInheritanceInfo = &inheritance_info;
+
+        if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer");
+        }
+
+        setViewportAndScissor(command_buffer);
+
+        return command_buffer;
+    }
+
+    void setViewportAndScissor(VkCommandBuffer command_buffer)
+    {
         VkViewport viewport{};
 
         viewport.x = 0.0f;
@@ -150,6 +319,8 @@ public:
         );
 
         vkCmdEndRenderPass(command_buffer);
+
+        profiler.endScope(command_buffer, pass_scope);
     }
 
     int getFrameIndex() const
@@ -159,18 +330,84 @@ public:
         return current_frame_index;
     }
 
+    const FrameTimings &getFrameTimings() const
+    {
+        return timings;
+    }
+
+    // scratch memory for the frame being recorded, released when this frame slot comes around again
+    FrameArena &getFrameArena()
+    {
+        assert(is_frame_started && "cannot get frame arena when frame not in progress");
+
+        return *frame_arenas[current_frame_index];
+    }
+
+    // mapped GPU memory for per-frame uniform, storage, vertex and indirect data, rewound with the
+    // frame arena
+    FrameRing &getFrameRing()
+    {
+        assert(is_frame_started && "cannot get frame ring when frame not in progress");
+
+        return frame_ring;
+    }
+
+    uint32_t framesInFlight() const
+    {
+        return swap_chain_config.frames_in_flight;
+    }
+
+    VkPresentModeKHR getPresentMode() const
+    {
+        return swap_chain->getPresentMode();
+    }
+
+    size_t imageCount() const
+    {
+        return swap_chain->imageCount();
+    }
+
+    // blocks until the next frame slot is free, beginFrame will then not wait on the GPU
+    void waitForFrameSlot()
+    {
+        assert(!is_frame_started && "cannot wait for a frame slot while a frame is in progress");
+
+        swap_chain->waitForFrameFence();
+    }
+
+    // render thread only, callers may add their own scopes on the current command buffer
+    GpuProfiler &getProfiler()
+    {
+        return profiler;
+    }
+
 private:
+    struct SecondaryCommandPool
+    {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> command_buffers;
+        size_t used = 0;
+    };
+
     Window &window;
     Device &device;
+    SwapChain::Config swap_chain_config;
     std::unique_ptr<SwapChain> swap_chain;
     std::vector<VkCommandBuffer> command_buffers;
+    std::vector<std::unique_ptr<FrameArena>> frame_arenas;
+    std::array<std::vector<SecondaryCommandPool>, SwapChain::MAX_FRAMES_IN_FLIGHT> secondary_pools;
     uint32_t current_image_index;
     int current_frame_index{0};
     bool is_frame_started{false};
+    GpuProfiler profiler;
+    FrameRing frame_ring;
+    GpuProfiler::ScopeId frame_scope = GpuProfiler::NO_SCOPE;
+    GpuProfiler::ScopeId pass_scope = GpuProfiler::NO_SCOPE;
+    FrameTimings timings;
 
     void createCommandBuffers()
     {
-        command_buffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        command_buffers.resize(swap_chain_config.frames_in_flight);
 
         VkCommandBufferAllocateInfo alloc_info{};
 
@@ -184,6 +421,22 @@ private:
         }
     }
 
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void destroySecondaryCommandPools()
+    {
+        for (auto &frame: secondary_pools) {
+            for (auto &slot: frame) {
+                vkDestroyCommandPool(device.device(), slot.pool, nullptr);
+            }
+
+            frame.clear();
+        }
+    }
+
     void freeCommandBuffers()
     {
         vkFreeCommandBuffers(
@@ -196,33 +449,37 @@ private:
         command_buffers.clear();
     }
 
-    void recreateSwapChain()
+    // runs on the render thread, so instead of waiting for GLFW events while the window is minimized
+    // it gives up and lets the next frame try again. the device is not idled, frames still in flight
+    // finish on the old swap chain, which is kept alive until they retired
+    bool recreateSwapChain()
     {
         auto extent = window.getExtent();
 
-        while (extent.width == 0 || extent.height == 0) {
-            extent = window.getExtent();
-            glfwWaitEvents();
+        if (extent.width == 0 || extent.height == 0) {
+            return false;
         }
 
-        vkDeviceWaitIdle(device.device());
+        window.resetWindowResizeFlag();
 
+        // command buffers belong to frames in flight rather than images, so they survive recreation
         if (swap_chain == nullptr) {
-            swap_chain = std::make_unique<SwapChain>(device, extent);
+            swap_chain = std::make_unique<SwapChain>(device, extent, swap_chain_config);
         } else {
             std::shared_ptr<SwapChain> old_swap_chain = std::move(swap_chain);
 
-            swap_chain = std::make_unique<SwapChain>(device, extent, old_swap_chain);
+            swap_chain = std::make_unique<SwapChain>(device, extent, swap_chain_config, old_swap_chain);
 
             if (!old_swap_chain->compareSwapFormats(*swap_chain.get())) {
                 throw std::runtime_error("swap chain image(or depth) format has changed");
             }
 
-            if (swap_chain->imageCount() != command_buffers.size()) {
-                freeCommandBuffers();
-                createCommandBuffers();
-            }
+            device.deletionQueue().defer([retired = std::move(old_swap_chain)]() mutable {
+                retired.reset();
+            });
         }
+
+        return true;
     }
 };
 
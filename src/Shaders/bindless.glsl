@@ -0,0 +1,17 @@
+#ifndef BINDLESS_GLSL
+#define BINDLESS_GLSL
+
+// the device's bindless table as set 1, a pipeline including this file adds
+// BindlessTable::getLayout() as its second set layout and binds it with BindlessTable::bind. indices
+// come from BindlessTable::addTexture and addBuffer, wrap them in nonuniformEXT when they differ
+// within a draw
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+layout (set = 1, binding = 1) readonly buffer BindlessBuffer {
+    uint words[];
+} buffers[];
+
+#endif
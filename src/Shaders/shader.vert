@@ -3,12 +3,24 @@
 layout (location = 0) in vec2 position;
 layout (location = 1) in vec3 color;
 
-layout (push_constant) uniform Push {
-    mat2 transform;
-    vec2 offset;
-    vec3 color;
-} push;
+layout (location = 2) in vec2 instanceTransformColumn0;
+layout (location = 3) in vec2 instanceTransformColumn1;
+layout (location = 4) in vec2 instanceOffset;
+layout (location = 5) in vec3 instanceColor;
+
+layout (location = 0) out vec3 fragColor;
+
+layout (set = 0, binding = 0) uniform FrameGlobals {
+    vec2 viewScale;
+    vec2 viewOffset;
+    float time;
+} globals;
 
 void main() {
-    gl_Position = vec4(push.transform * position + push.offset, 0.0, 1.0);
+    mat2 transform = mat2(instanceTransformColumn0, instanceTransformColumn1);
+
+    vec2 world = transform * position + instanceOffset;
+
+    gl_Position = vec4(world * globals.viewScale + globals.viewOffset, 0.0, 1.0);
+    fragColor = instanceColor;
 }
@@ -0,0 +1,199 @@
+#ifndef MELLIANCLIENT_SIMULATION_H
+#define MELLIANCLIENT_SIMULATION_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <memory>
+#include <vector>
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+// Advances the entity store in fixed steps on the job system. Each launch consumes whole steps from
+// the accumulated frame time and then blends the last two simulated states by the leftover fraction
+// into the snapshot it was given, which the caller hands to the renderer once wait() returned.
+//
+// Only translation and rotation are simulated, the other components are copied into the snapshot as
+// they are, so the renderer never reads the store and a published snapshot stays valid whatever the
+// store does afterwards. Creating or destroying entities is only allowed between wait() and launch(),
+// while no step reads the store, wait() asserts that nothing changed underneath a running launch.
+// Interpolation is indexed by dense slot, so the next launch after such a change restarts it from
+// the store as it is, the same as reset().
+class Simulation
+{
+public:
+    static constexpr double STEP_SECONDS = 1. / 60.;
+    static constexpr uint32_t MAX_STEPS_PER_LAUNCH = 8;
+    static constexpr float ROTATION_SPEED = .6f;
+    static constexpr uint32_t UPDATE_GRAIN = 4096;
+
+    // everything the renderer needs from the store, slot i of every array belongs to the same entity.
+    // the model table holds the models by shared_ptr so they outlive the frame that draws them
+    struct Snapshot
+    {
+        std::vector<glm::vec2> translations;
+        std::vector<glm::vec2> scales;
+        std::vector<float> rotations;
+        std::vector<glm::vec3> colors;
+        std::vector<EntityStore::ModelHandle> models;
+        std::vector<std::shared_ptr<Model>> model_table;
+
+        uint32_t size() const
+        {
+            return static_cast<uint32_t>(models.size());
+        }
+    };
+
+    Simulation(JobSystem &jobs, EntityStore &entities) : jobs{jobs}, entities{entities}
+    {
+    }
+
+    ~Simulation()
+    {
+        jobs.wait(running);
+    }
+
+    Simulation(const Simulation &) = delete;
+
+    Simulation &operator=(Simulation &&) = delete;
+
+    // restarts interpolation from the store as it is now
+    void reset()
+    {
+        assert(running.isDone() && "cannot reset while a step is running");
+
+        capturePrevious();
+
+        accumulator = 0.;
+    }
+
+    void launch(double frame_seconds, Snapshot &snapshot)
+    {
+        assert(running.isDone() && "previous launch has not been waited on");
+
+        if (entities.structureVersion() != captured_version) {
+            reset();
+        }
+
+        launched_version = entities.structureVersion();
+        launched = true;
+
+        accumulator = std::min(accumulator + frame_seconds, MAX_STEPS_PER_LAUNCH * STEP_SECONDS);
+
+        launched_steps = static_cast<uint32_t>(accumulator / STEP_SECONDS);
+        accumulator -= launched_steps * STEP_SECONDS;
+        launched_alpha = static_cast<float>(accumulator / STEP_SECONDS);
+
+        auto model_table = entities.modelTable();
+
+        snapshot.model_table.assign(model_table.begin(), model_table.end());
+
+        // steps and alpha are read from the members, a capture this small is not heap allocated
+        jobs.submit([this, &snapshot]() {
+            for (uint32_t i = 0; i < launched_steps; i++) {
+                if (i + 1 == launched_steps) {
+                    capturePrevious();
+                }
+
+                step();
+            }
+
+            blend(snapshot, launched_alpha);
+        }, &running);
+    }
+
+    void wait()
+    {
+        jobs.wait(running);
+
+        assert(
+            (!launched || entities.structureVersion() == launched_version) &&
+            "entities changed while a step was running"
+        );
+
+        launched = false;
+    }
+
+private:
+    JobSystem &jobs;
+    EntityStore &entities;
+    JobCounter running;
+    double accumulator = 0.;
+    uint64_t captured_version = 0;
+    uint64_t launched_version = 0;
+    bool launched = false;
+    uint32_t launched_steps = 0;
+    float launched_alpha = 0.f;
+    std::vector<glm::vec2> previous_translations;
+    std::vector<float> previous_rotations;
+
+    void step()
+    {
+        TRACE_ZONE("Simulation::step");
+
+        auto rotations = entities.rotations();
+
+        jobs.parallelFor(entities.size(), UPDATE_GRAIN, [rotations](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                rotations[i] = glm::mod(
+                    rotations[i] + ROTATION_SPEED * static_cast<float>(STEP_SECONDS),
+                    glm::two_pi<float>()
+                );
+            }
+        });
+    }
+
+    void capturePrevious()
+    {
+        auto translations = entities.translations();
+        auto rotations = entities.rotations();
+
+        previous_translations.assign(translations.begin(), translations.end());
+        previous_rotations.assign(rotations.begin(), rotations.end());
+        captured_version = entities.structureVersion();
+    }
+
+    // rotations wrap at 2pi, so they are blended along the shorter arc
+    void blend(Snapshot &snapshot, float alpha)
+    {
+        TRACE_ZONE("Simulation::blend");
+
+        auto translations = entities.translations();
+        auto scales = entities.scales();
+        auto rotations = entities.rotations();
+        auto colors = entities.colors();
+        auto models = entities.models();
+
+        snapshot.translations.resize(entities.size());
+        snapshot.scales.resize(entities.size());
+        snapshot.rotations.resize(entities.size());
+        snapshot.colors.resize(entities.size());
+        snapshot.models.resize(entities.size());
+
+        jobs.parallelFor(entities.size(), UPDATE_GRAIN, [&, alpha](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                float delta = rotations[i] - previous_rotations[i];
+
+                if (delta > glm::pi<float>()) {
+                    delta -= glm::two_pi<float>();
+                } else if (delta < -glm::pi<float>()) {
+                    delta += glm::two_pi<float>();
+                }
+
+                snapshot.translations[i] = glm::mix(previous_translations[i], translations[i], alpha);
+                snapshot.rotations[i] = previous_rotations[i] + delta * alpha;
+                snapshot.scales[i] = scales[i];
+                snapshot.colors[i] = colors[i];
+                snapshot.models[i] = models[i];
+            }
+        });
+    }
+};
+
+#endif //MELLIANCLIENT_SIMULATION_H
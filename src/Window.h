@@ -4,55 +4,177 @@
 #define GLFW_INCLUDE_VULKAN
 
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
 #include <string>
-
+#include <vector>
+
+// The size and resize flag are written by the GLFW callback on the main thread and read by the
+// render thread, so both are atomic and the size is packed to be read as one value.
+//
+// A headless window never touches GLFW, its surface comes from VK_EXT_headless_surface so the
+// whole frame loop runs on machines without a display. Event waits are then served by a condition
+// variable that postEmptyEvent signals.
 class Window
 {
 public:
-    Window(int w, int h, std::string name) : width{w}, height{h}, name{name}
+    Window(int w, int h, std::string name, bool headless = false)
+        : extent{packExtent(w, h)}, name{name}, headless{headless}
     {
-        initWindow();
+        if (!headless) {
+            initWindow();
+        }
     }
 
     ~Window()
     {
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
     bool shouldClose()
     {
-        return glfwWindowShouldClose(window);
+        return close_requested.load(std::memory_order_acquire) || (!headless && glfwWindowShouldClose(window));
+    }
+
+    // safe from any thread
+    void requestClose()
+    {
+        close_requested.store(true, std::memory_order_release);
+        postEmptyEvent();
+    }
+
+    bool isHeadless() const
+    {
+        return headless;
+    }
+
+    std::vector<const char *> getRequiredInstanceExtensions() const
+    {
+        if (headless) {
+            return {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+        }
+
+        uint32_t count = 0;
+        const char **extensions = glfwGetRequiredInstanceExtensions(&count);
+
+        return {extensions, extensions + count};
     }
 
     void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface)
     {
+        if (headless) {
+            createHeadlessSurface(instance, surface);
+
+            return;
+        }
+
         if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
             throw std::runtime_error("failed to create window surface");
         }
     }
 
-    VkExtent2D getExtent()
+    void pollEvents()
+    {
+        if (!headless) {
+            glfwPollEvents();
+        }
+    }
+
+    void waitEvents()
+    {
+        if (headless) {
+            std::unique_lock<std::mutex> lock{event_mutex};
+
+            event_condition.wait(lock, [this]() { return event_posted; });
+            event_posted = false;
+        } else {
+            glfwWaitEvents();
+        }
+    }
+
+    void waitEventsTimeout(double seconds)
+    {
+        if (headless) {
+            std::unique_lock<std::mutex> lock{event_mutex};
+
+            event_condition.wait_for(lock, std::chrono::duration<double>(seconds), [this]() { return event_posted; });
+            event_posted = false;
+        } else {
+            glfwWaitEventsTimeout(seconds);
+        }
+    }
+
+    // safe from any thread, wakes the thread blocked in waitEvents
+    void postEmptyEvent()
     {
-        return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        if (headless) {
+            {
+                std::lock_guard<std::mutex> lock{event_mutex};
+
+                event_posted = true;
+            }
+
+            event_condition.notify_one();
+        } else {
+            glfwPostEmptyEvent();
+        }
     }
 
-    bool wasWindowResized()
+    VkExtent2D getExtent() const
     {
-        return frame_buffer_resize;
+        uint64_t packed = extent.load(std::memory_order_acquire);
+
+        return {static_cast<uint32_t>(packed >> 32), static_cast<uint32_t>(packed)};
+    }
+
+    bool isMinimized() const
+    {
+        auto current = getExtent();
+
+        return current.width == 0 || current.height == 0;
+    }
+
+    bool wasWindowResized() const
+    {
+        return frame_buffer_resize.load(std::memory_order_acquire);
     }
 
     void resetWindowResizeFlag()
     {
-        frame_buffer_resize = false;
+        frame_buffer_resize.store(false, std::memory_order_release);
+    }
+
+    // a drag delivers a burst of resize events, this tells how long the size has been stable
+    std::chrono::steady_clock::duration timeSinceResize() const
+    {
+        std::chrono::steady_clock::duration last{last_resize.load(std::memory_order_acquire)};
+
+        return std::chrono::steady_clock::now().time_since_epoch() - last;
     }
 
 private:
-    int width;
-    int height;
-    bool frame_buffer_resize = false;
+    std::atomic<uint64_t> extent;
+    std::atomic<bool> frame_buffer_resize{false};
+    std::atomic<bool> close_requested{false};
+    std::atomic<std::chrono::steady_clock::rep> last_resize{0};
     std::string name;
-    GLFWwindow *window;
+    bool headless;
+    GLFWwindow *window = nullptr;
+    std::mutex event_mutex;
+    std::condition_variable event_condition;
+    bool event_posted = false;
+
+    static uint64_t packExtent(int width, int height)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(width)) << 32 | static_cast<uint32_t>(height);
+    }
 
     void initWindow()
     {
@@ -60,19 +182,49 @@ private:
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-        window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+        auto initial = getExtent();
+
+        window = glfwCreateWindow(
+            static_cast<int>(initial.width),
+            static_cast<int>(initial.height),
+            name.c_str(),
+            nullptr,
+            nullptr
+        );
 
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, frameBufferResizeCallback);
     }
 
+    void createHeadlessSurface(VkInstance instance, VkSurfaceKHR *surface)
+    {
+        auto create_headless_surface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+            vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT")
+        );
+
+        if (create_headless_surface == nullptr) {
+            throw std::runtime_error("failed to load vkCreateHeadlessSurfaceEXT");
+        }
+
+        VkHeadlessSurfaceCreateInfoEXT create_info{};
+
+        create_info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+        if (create_headless_surface(instance, &create_info, nullptr, surface) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create headless surface");
+        }
+    }
+
     static void frameBufferResizeCallback(GLFWwindow *window, int width, int height)
     {
         auto new_window = reinterpret_cast<Window *>(glfwGetWindowUserPointer(window));
 
-        new_window->frame_buffer_resize = true;
-        new_window->width = width;
-        new_window->height = height;
+        new_window->extent.store(packExtent(width, height), std::memory_order_release);
+        new_window->last_resize.store(
+            std::chrono::steady_clock::now().time_since_epoch().count(),
+            std::memory_order_release
+        );
+        new_window->frame_buffer_resize.store(true, std::memory_order_release);
     }
 };
 
@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "EntityStore.h"
+#include "TestCheck.h"
+
+// the store only keeps the models as keys, so a null model is enough and no device is needed
+
+static glm::vec3 tag(uint32_t id)
+{
+    return {static_cast<float>(id), 0.f, 0.f};
+}
+
+static void reuseBumpsGeneration()
+{
+    EntityStore store;
+    auto model = store.addModel(nullptr);
+
+    Entity first = store.create(model);
+
+    CHECK(store.destroy(first));
+
+    Entity second = store.create(model);
+
+    CHECK_EQ(second.index, first.index);
+    CHECK_EQ(second.generation, first.generation + 1);
+}
+
+static void staleHandlesAreRejected()
+{
+    EntityStore store;
+    auto model = store.addModel(nullptr);
+
+    Entity stale = store.create(model, {}, tag(1));
+
+    store.destroy(stale);
+
+    Entity reused = store.create(model, {}, tag(2));
+
+    CHECK_EQ(reused.index, stale.index);
+    CHECK(!store.contains(stale));
+    CHECK(store.contains(reused));
+
+    // a stale destroy must leave the slot's new owner alone
+    CHECK(!store.destroy(stale));
+    CHECK(store.contains(reused));
+    CHECK_EQ(store.size(), 1u);
+    CHECK(store.colors()[store.indexOf(reused)] == tag(2));
+}
+
+static void freeSlotsAreReusedLastInFirstOut()
+{
+    EntityStore store;
+    auto model = store.addModel(nullptr);
+
+    Entity a = store.create(model);
+    store.create(model);
+    Entity c = store.create(model);
+
+    store.destroy(a);
+    store.destroy(c);
+
+    CHECK_EQ(store.create(model).index, c.index);
+    CHECK_EQ(store.create(model).index, a.index);
+    CHECK_EQ(store.create(model).index, 3u);
+}
+
+static void swapRemoveRemapsMovedEntity()
+{
+    EntityStore store;
+    auto model = store.addModel(nullptr);
+
+    Entity a = store.create(model, {}, tag(1));
+    Entity b = store.create(model, {}, tag(2));
+    Entity c = store.create(model, {}, tag(3));
+
+    store.destroy(a);
+
+    // the last dense slot moved into the hole
+    CHECK_EQ(store.size(), 2u);
+    CHECK_EQ(store.indexOf(c), 0u);
+    CHECK(store.entities()[0] == c);
+    CHECK(store.colors()[store.indexOf(c)] == tag(3));
+    CHECK_EQ(store.indexOf(b), 1u);
+    CHECK(store.colors()[store.indexOf(b)] == tag(2));
+}
+
+// live handles never share a slot, every handle ever destroyed stays dead and every live entity still
+// finds its own components
+static void churnNeverAliasesHandles()
+{
+    EntityStore store;
+    auto model = store.addModel(nullptr);
+    std::mt19937 random{42};
+    std::vector<Entity> live;
+    std::vector<uint32_t> live_ids;
+    std::vector<Entity> dead;
+    uint32_t next_id = 0;
+
+    for (int step = 0; step < 20000; step++) {
+        if (live.empty() || random() % 3 != 0) {
+            Entity entity = store.create(model, {}, tag(next_id));
+
+            for (auto other: live) {
+                CHECK(other.index != entity.index);
+            }
+
+            live.push_back(entity);
+            live_ids.push_back(next_id++);
+        } else {
+            size_t victim = random() % live.size();
+
+            CHECK(store.destroy(live[victim]));
+
+            dead.push_back(live[victim]);
+            live[victim] = live.back();
+            live_ids[victim] = live_ids.back();
+            live.pop_back();
+            live_ids.pop_back();
+        }
+
+        // keeps the live set small enough that slots are reused over and over
+        if (live.size() > 64) {
+            for (auto entity: live) {
+                store.destroy(entity);
+                dead.push_back(entity);
+            }
+
+            live.clear();
+            live_ids.clear();
+        }
+    }
+
+    std::vector<bool> used(store.size() + dead.size() + 1, false);
+
+    for (size_t i = 0; i < live.size(); i++) {
+        CHECK(store.contains(live[i]));
+        CHECK(!used[live[i].index]);
+        CHECK(store.colors()[store.indexOf(live[i])] == tag(live_ids[i]));
+
+        used[live[i].index] = true;
+    }
+
+    for (auto entity: dead) {
+        CHECK(!store.contains(entity));
+    }
+
+    CHECK_EQ(store.size(), static_cast<uint32_t>(live.size()));
+}
+
+int main()
+{
+    reuseBumpsGeneration();
+    staleHandlesAreRejected();
+    freeSlotsAreReusedLastInFirstOut();
+    swapRemoveRemapsMovedEntity();
+    churnNeverAliasesHandles();
+
+    return TestCheck::report("EntityStoreTest");
+}
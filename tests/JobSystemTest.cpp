@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "JobSystem.h"
+#include "TestCheck.h"
+
+// a thread outside the pool runs the jobs of the counter it waits on, and nothing else
+static void waitOnlyRunsCountedJobs()
+{
+    JobSystem system{1};
+    std::atomic<bool> gate_open{false};
+    std::atomic<bool> gate_started{false};
+    std::atomic<bool> foreign_ran_on_waiter{false};
+    JobCounter gate;
+    JobCounter counted;
+    std::thread::id waiter_id;
+
+    // keeps the only worker busy until the end
+    system.submit([&gate_open, &gate_started]() {
+        gate_started = true;
+
+        while (!gate_open.load()) {
+            std::this_thread::yield();
+        }
+    }, &gate);
+
+    while (!gate_started.load()) {
+        std::this_thread::yield();
+    }
+
+    // the foreign job is queued last, a waiter taking the newest job would pick it first
+    system.submit([]() {}, &counted);
+    system.submit([&foreign_ran_on_waiter, &waiter_id]() {
+        foreign_ran_on_waiter = std::this_thread::get_id() == waiter_id;
+    });
+
+    std::thread waiter{[&]() {
+        waiter_id = std::this_thread::get_id();
+        system.wait(counted);
+    }};
+
+    waiter.join();
+
+    CHECK(counted.isDone());
+    CHECK(!gate.isDone());
+    CHECK(!foreign_ran_on_waiter.load());
+
+    gate_open = true;
+    system.wait(gate);
+}
+
+// with nothing of its own left to run the waiter blocks until a worker finishes the counter
+static void waitWakesWhenWorkerFinishes()
+{
+    JobSystem system{2};
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    JobCounter counted;
+
+    system.submit([&]() {
+        started = true;
+
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    }, &counted);
+
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+
+    std::thread waiter{[&]() { system.wait(counted); }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    CHECK(!counted.isDone());
+
+    release = true;
+    waiter.join();
+
+    CHECK(counted.isDone());
+}
+
+static void continuationsRunAfterDependency()
+{
+    JobSystem system{2};
+    std::atomic<int> order{0};
+    int first = -1;
+    int second = -1;
+    JobCounter dependency;
+    JobCounter counter;
+
+    system.submit([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        first = order++;
+    }, &dependency);
+    system.submitAfter(dependency, [&]() { second = order++; }, &counter);
+
+    system.wait(counter);
+    system.wait(dependency);
+
+    CHECK_EQ(first, 0);
+    CHECK_EQ(second, 1);
+}
+
+int main()
+{
+    waitOnlyRunsCountedJobs();
+    waitWakesWhenWorkerFinishes();
+    continuationsRunAfterDependency();
+
+    return TestCheck::report("JobSystemTest");
+}
@@ -0,0 +1,209 @@
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "TestCheck.h"
+
+// MemoryBlock and the defragmentation planner make no Vulkan calls, so everything here runs
+// without a device
+
+static void bestFitPicksTightestRange()
+{
+    MemoryBlock block{1024};
+    VkDeviceSize a, b, c, d, offset;
+
+    CHECK(block.allocate(100, 1, a));
+    CHECK(block.allocate(300, 1, b));
+    CHECK(block.allocate(100, 1, c));
+    CHECK(block.allocate(200, 1, d));
+
+    // leaves free ranges of 300 at b and 324 at the end
+    block.free(b);
+
+    CHECK(block.allocate(280, 1, offset));
+    CHECK_EQ(offset, b);
+
+    // only the tail fits now
+    CHECK(block.allocate(300, 1, offset));
+    CHECK_EQ(offset, d + 200);
+
+    CHECK(!block.allocate(64, 1, offset));
+}
+
+static void offsetsHonourAlignment()
+{
+    MemoryBlock block{4096};
+    VkDeviceSize first, second, third;
+
+    CHECK(block.allocate(10, 1, first));
+    CHECK(block.allocate(64, 256, second));
+    CHECK(block.allocate(1, 64, third));
+
+    CHECK_EQ(first, 0u);
+    CHECK_EQ(second % 256, 0u);
+    CHECK_EQ(second, 256u);
+    CHECK_EQ(third % 64, 0u);
+    CHECK_EQ(third, 320u);
+}
+
+static void paddingIsCounted()
+{
+    MemoryBlock block{4096};
+    VkDeviceSize first, second;
+
+    CHECK(block.allocate(10, 1, first));
+    CHECK(block.allocate(64, 256, second));
+
+    CHECK_EQ(block.getUsed(), 74u);
+    CHECK_EQ(block.getPadding(), 246u);
+    CHECK_EQ(block.getFree(), 4096u - 74u - 246u);
+    // the padding is held by the allocation, not left behind as a free sliver
+    CHECK_EQ(block.freeRangeCount(), 1u);
+    CHECK_EQ(block.largestFreeRange(), block.getFree());
+
+    block.free(second);
+
+    CHECK_EQ(block.getPadding(), 0u);
+    CHECK_EQ(block.freeRangeCount(), 1u);
+    CHECK_EQ(block.largestFreeRange(), 4096u - 10u);
+}
+
+static void freeCoalescesNeighbours()
+{
+    MemoryBlock block{1024};
+    VkDeviceSize a, b, c, d;
+
+    CHECK(block.allocate(256, 1, a));
+    CHECK(block.allocate(256, 1, b));
+    CHECK(block.allocate(256, 1, c));
+    CHECK(block.allocate(256, 1, d));
+    CHECK_EQ(block.freeRangeCount(), 0u);
+
+    block.free(a);
+    block.free(c);
+    CHECK_EQ(block.freeRangeCount(), 2u);
+
+    // joins both the range before and the range after it
+    block.free(b);
+    CHECK_EQ(block.freeRangeCount(), 1u);
+    CHECK_EQ(block.largestFreeRange(), 768u);
+
+    block.free(d);
+    CHECK(block.isEmpty());
+    CHECK_EQ(block.freeRangeCount(), 1u);
+    CHECK_EQ(block.largestFreeRange(), 1024u);
+    CHECK_EQ(block.getUsed(), 0u);
+}
+
+static void freeRejectsUnknownOffsets()
+{
+    MemoryBlock block{1024};
+    VkDeviceSize offset;
+
+    CHECK(block.allocate(64, 1, offset));
+
+    bool threw = false;
+
+    try {
+        block.free(offset + 1);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+
+    CHECK(threw);
+}
+
+static void defragmentationMovesSparseBlocks()
+{
+    MemoryAllocator::Pool pool;
+
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+
+    auto &full = *pool[0];
+    auto &sparse = *pool[1];
+    VkDeviceSize offset, sparse_offset;
+
+    CHECK(full.allocate(512, 1, offset));
+    CHECK(sparse.allocate(64, 16, sparse_offset));
+
+    std::vector<MemoryAllocator::DefragmentationMove> moves;
+
+    MemoryAllocator::planDefragmentation(pool, .25f, moves);
+
+    CHECK_EQ(moves.size(), 1u);
+    CHECK(moves[0].source.block == &sparse);
+    CHECK_EQ(moves[0].source.offset, sparse_offset);
+    CHECK(moves[0].destination.block == &full);
+    CHECK_EQ(moves[0].destination.offset % 16, 0u);
+    CHECK_EQ(moves[0].destination.size, 64u);
+
+    // the destination is reserved, finishing the move empties the sparse block
+    CHECK_EQ(full.allocationCount(), 2u);
+    sparse.free(moves[0].source.offset);
+    CHECK(sparse.isEmpty());
+}
+
+static void defragmentationLeavesBusyBlocks()
+{
+    MemoryAllocator::Pool pool;
+
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+
+    VkDeviceSize offset;
+
+    CHECK(pool[0]->allocate(512, 1, offset));
+    CHECK(pool[1]->allocate(400, 1, offset));
+
+    std::vector<MemoryAllocator::DefragmentationMove> moves;
+
+    MemoryAllocator::planDefragmentation(pool, .25f, moves);
+
+    CHECK(moves.empty());
+}
+
+// the first sparse block lands in the second, which is sparse as well but must not be evacuated
+// into the third afterwards, that would move the same allocation twice
+static void defragmentationMovesEachAllocationOnce()
+{
+    MemoryAllocator::Pool pool;
+
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+    pool.push_back(std::make_unique<MemoryBlock>(1024));
+
+    VkDeviceSize offset;
+
+    CHECK(pool[0]->allocate(64, 1, offset));
+    CHECK(pool[1]->allocate(150, 1, offset));
+    CHECK(pool[2]->allocate(600, 1, offset));
+
+    std::vector<MemoryAllocator::DefragmentationMove> moves;
+
+    MemoryAllocator::planDefragmentation(pool, .25f, moves);
+
+    CHECK_EQ(moves.size(), 1u);
+    CHECK(moves[0].source.block == pool[0].get());
+    CHECK(moves[0].destination.block == pool[1].get());
+
+    for (auto &move: moves) {
+        for (auto &other: moves) {
+            CHECK(move.source.block != other.destination.block);
+        }
+    }
+}
+
+int main()
+{
+    bestFitPicksTightestRange();
+    offsetsHonourAlignment();
+    paddingIsCounted();
+    freeCoalescesNeighbours();
+    freeRejectsUnknownOffsets();
+    defragmentationMovesSparseBlocks();
+    defragmentationLeavesBusyBlocks();
+    defragmentationMovesEachAllocationOnce();
+
+    return TestCheck::report("MemoryAllocatorTest");
+}
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "TestCheck.h"
+
+// the store only keeps the models as keys, so null models are enough and no device is needed
+
+static constexpr uint32_t MODEL_COUNT = 4;
+
+// every component of an entity is tagged with its model, so a snapshot that mixed up slots shows
+static Entity spawn(EntityStore &store, EntityStore::ModelHandle model)
+{
+    Transform2dComponent transform{};
+    auto tag = static_cast<float>(model);
+
+    transform.scale = {tag, tag};
+
+    return store.create(model, transform, {tag, 0.f, 0.f});
+}
+
+static bool consistent(const Simulation::Snapshot &snapshot)
+{
+    if (snapshot.translations.size() != snapshot.size()
+        || snapshot.scales.size() != snapshot.size()
+        || snapshot.rotations.size() != snapshot.size()
+        || snapshot.colors.size() != snapshot.size()
+        || snapshot.model_table.size() != MODEL_COUNT) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < snapshot.size(); i++) {
+        auto tag = static_cast<float>(snapshot.models[i]);
+
+        if (snapshot.scales[i].x != tag || snapshot.colors[i].x != tag) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// entities are created and destroyed every frame while another thread reads the previous snapshot,
+// the way the render thread reads a published packet
+static void churnNextToReader()
+{
+    JobSystem jobs;
+    EntityStore store;
+    std::mt19937 random{7};
+    std::uniform_int_distribution<EntityStore::ModelHandle> model{0, MODEL_COUNT - 1};
+
+    for (uint32_t i = 0; i < MODEL_COUNT; i++) {
+        store.addModel(nullptr);
+    }
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        spawn(store, model(random));
+    }
+
+    Simulation simulation{jobs, store};
+    Simulation::Snapshot snapshots[2];
+    uint32_t inconsistent = 0;
+
+    simulation.reset();
+    simulation.launch(Simulation::STEP_SECONDS, snapshots[0]);
+
+    for (uint32_t frame = 1; frame < 200; frame++) {
+        simulation.wait();
+
+        auto &published = snapshots[(frame - 1) % 2];
+
+        CHECK_EQ(published.size(), store.size());
+
+        std::thread reader{[&published, &inconsistent]() {
+            inconsistent += consistent(published) ? 0 : 1;
+        }};
+
+        // the store grows and shrinks so its arrays get reallocated under the reader
+        uint32_t destroyed = frame % 2 == 0 ? 300 : 100;
+        uint32_t created = frame % 2 == 0 ? 100 : 300;
+
+        for (uint32_t i = 0; i < destroyed && store.size() > 0; i++) {
+            std::uniform_int_distribution<uint32_t> slot{0, store.size() - 1};
+
+            store.destroy(store.entities()[slot(random)]);
+        }
+
+        for (uint32_t i = 0; i < created; i++) {
+            spawn(store, model(random));
+        }
+
+        simulation.launch(Simulation::STEP_SECONDS, snapshots[frame % 2]);
+        reader.join();
+    }
+
+    simulation.wait();
+
+    CHECK_EQ(inconsistent, 0u);
+    CHECK(consistent(snapshots[1]));
+    CHECK_EQ(snapshots[1].size(), store.size());
+}
+
+int main()
+{
+    churnNextToReader();
+
+    return TestCheck::report("SimulationTest");
+}
@@ -0,0 +1,41 @@
+#ifndef MELLIANCLIENT_TESTCHECK_H
+#define MELLIANCLIENT_TESTCHECK_H
+
+#include <cstdlib>
+#include <iostream>
+
+// Just enough of a test harness for ctest: failed checks are printed and counted, report turns the
+// count into the exit code.
+class TestCheck
+{
+public:
+    static void fail(const char *file, int line, const char *expression)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+        failures++;
+    }
+
+    static int report(const char *name)
+    {
+        if (failures != 0) {
+            std::cerr << name << ": " << failures << " check(s) failed" << std::endl;
+
+            return EXIT_FAILURE;
+        }
+
+        std::cout << name << ": passed" << std::endl;
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    static inline int failures = 0;
+};
+
+#define CHECK(expression) \
+    ((expression) ? (void) 0 : TestCheck::fail(__FILE__, __LINE__, #expression))
+
+#define CHECK_EQ(actual, expected) \
+    (((actual) == (expected)) ? (void) 0 : TestCheck::fail(__FILE__, __LINE__, #actual " == " #expected))
+
+#endif //MELLIANCLIENT_TESTCHECK_H
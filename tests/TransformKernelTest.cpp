@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <numbers>
+#include <vector>
+#include "TestCheck.h"
+#include "TransformKernel.h"
+
+struct Path
+{
+    const char *name;
+    TransformKernel::Function function;
+};
+
+// avx2 is only swept on CPUs that can run it
+static std::vector<Path> paths()
+{
+    std::vector<Path> result{{"scalar", &TransformKernel::scalar}};
+
+#ifdef MELLIANCLIENT_TRANSFORMKERNEL_X86
+    result.push_back({"sse2", &TransformKernel::sse2});
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        result.push_back({"avx2", &TransformKernel::avx2});
+    }
+#endif
+
+    return result;
+}
+
+struct Components
+{
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec2> translations;
+    std::vector<glm::vec2> scales;
+    std::vector<float> rotations;
+    std::vector<glm::vec3> colors;
+
+    explicit Components(uint32_t count) :
+        indices(count), translations(count), scales(count, glm::vec2{1.f, 1.f}), rotations(count), colors(count)
+    {
+    }
+
+    TransformKernel::Input input() const
+    {
+        return {indices.data(), translations.data(), scales.data(), rotations.data(), colors.data()};
+    }
+};
+
+// largest distance of the unscaled rotation matrices from the exact sine and cosine
+static double sweep(TransformKernel::Function function, float low, float high, uint32_t count)
+{
+    Components components{count};
+    std::vector<Model::Instance> instances(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        components.indices[i] = i;
+        components.rotations[i] = low + (high - low) * (static_cast<float>(i) + .5f) / static_cast<float>(count);
+    }
+
+    function(components.input(), instances.data(), 0, count);
+
+    double error = 0.;
+
+    for (uint32_t i = 0; i < count; i++) {
+        double s = std::sin(static_cast<double>(components.rotations[i]));
+        double c = std::cos(static_cast<double>(components.rotations[i]));
+        auto &transform = instances[i].transform;
+
+        error = std::max(error, std::abs(transform[0][0] - c));
+        error = std::max(error, std::abs(transform[0][1] - s));
+        error = std::max(error, std::abs(transform[1][0] + s));
+        error = std::max(error, std::abs(transform[1][1] - c));
+    }
+
+    return error;
+}
+
+static void pathsStayWithinMaxError()
+{
+    for (auto &path: paths()) {
+        double unit = sweep(path.function, 0.f, 2.f * std::numbers::pi_v<float>, 1 << 20);
+        double full = sweep(path.function, -TransformKernel::MAX_ROTATION, TransformKernel::MAX_ROTATION, 1 << 22);
+
+        std::cout << path.name << ": max error " << unit << " on [0, 2pi), " << full << " on the full range"
+                  << std::endl;
+
+        CHECK(unit <= TransformKernel::MAX_ERROR);
+        CHECK(full <= TransformKernel::MAX_ERROR);
+    }
+}
+
+// gathered indices, scales and a range whose ends are not a multiple of the vector width
+static void pathsMatchScalarOnGatheredSlots()
+{
+    constexpr uint32_t count = 1001;
+    constexpr uint32_t begin = 3;
+    Components components{count};
+
+    for (uint32_t i = 0; i < count; i++) {
+        components.indices[i] = (i * 7919) % count;
+        components.translations[i] = {static_cast<float>(i), -static_cast<float>(i)};
+        components.scales[i] = {.5f + static_cast<float>(i % 7), 2.f - static_cast<float>(i % 3)};
+        components.rotations[i] = static_cast<float>(i) * .37f;
+        components.colors[i] = {static_cast<float>(i % 2), static_cast<float>(i % 5), 1.f};
+    }
+
+    std::vector<Model::Instance> expected(count);
+
+    TransformKernel::scalar(components.input(), expected.data(), begin, count);
+
+    for (auto &path: paths()) {
+        std::vector<Model::Instance> instances(count);
+
+        path.function(components.input(), instances.data(), begin, count);
+
+        for (uint32_t i = begin; i < count; i++) {
+            glm::vec2 scale = components.scales[components.indices[i]];
+            float tolerance = 2.f * TransformKernel::MAX_ERROR * std::max(std::abs(scale.x), std::abs(scale.y));
+
+            for (int column = 0; column < 2; column++) {
+                for (int row = 0; row < 2; row++) {
+                    float difference = instances[i].transform[column][row] - expected[i].transform[column][row];
+
+                    CHECK(std::abs(difference) <= tolerance);
+                }
+            }
+
+            CHECK(instances[i].offset == expected[i].offset);
+            CHECK(instances[i].color == expected[i].color);
+        }
+    }
+}
+
+int main()
+{
+    pathsStayWithinMaxError();
+    pathsMatchScalarOnGatheredSlots();
+
+    return TestCheck::report("TransformKernelTest");
+}